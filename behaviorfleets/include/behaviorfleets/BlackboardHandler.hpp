@@ -16,11 +16,17 @@
 #define BEHAVIORFLEETS__BLACKBOARDHANDLER_HPP_
 
 #include <string>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <vector>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "rclcpp/rclcpp.hpp"
 
@@ -28,46 +34,136 @@
 
 #include "bf_msgs/msg/blackboard.hpp"
 
+#include "behaviorfleets/KeyFilter.hpp"
+#include "behaviorfleets/PayloadCodec.hpp"
+#include "behaviorfleets/ShardMap.hpp"
+#include "behaviorfleets/Trace.hpp"
+#include "behaviorfleets/TypeRegistry.hpp"
+
 namespace BF
 {
 
 class BlackboardHandler : public rclcpp::Node
 {
 public:
+  RCLCPP_SMART_PTR_DEFINITIONS(BlackboardHandler)
+
   BlackboardHandler(const std::string robot_id, BT::Blackboard::Ptr blackboard);
   // BlackboardHandler(const std::string robot_id, BT::Blackboard::Ptr blackboard, std::chrono::milliseconds milis);
   virtual ~BlackboardHandler();
   bool updating_bb();
+  // flushes the writes covered by a held lease, clears the local blackboard, drops every
+  // other write in progress and what is known of the shared one, and synchronizes again
   void reset();
 
+  // writes made through the handler are sent without scanning the blackboard
+  template<typename T>
+  void set(const std::string & key, const T & value)
+  {
+    blackboard_->set(key, value);
+    notify_write(key);
+  }
+  // key written directly on the blackboard (any thread)
+  void notify_write(const std::string & key);
+  // compare the whole blackboard with key_states_ in the next cycle, to catch the writes
+  // made without notice (e.g. scripts during a tick)
+  void request_scan();
+
 private:
-  void blackboard_callback(bf_msgs::msg::Blackboard::UniquePtr msg);
-  std::string get_type(const char * port_name);
+  // connection to the manager of one shard and the write in progress on its keys
+  struct Shard
+  {
+    // requests to the manager, replies addressed to this robot, blackboard data and the
+    // manager's heartbeat
+    rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr pub;
+    rclcpp::Subscription<bf_msgs::msg::Blackboard>::SharedPtr reply_sub, data_sub;
+    rclcpp::Subscription<bf_msgs::msg::Blackboard>::SharedPtr heartbeat_sub;
+    std::set<std::string> pending_keys;  // changed locally, not yet sent to the manager
+    std::vector<std::string> granted_keys;
+    bool access_granted = false;
+    bool request_sent = false;
+    uint64_t grant_token = 0;  // fencing token of the last grant, echoed in the UPDATE
+    rclcpp::Time t_last_request;
+
+    // optimistic writes: CAS in flight and fallback to REQUEST/GRANT after a conflict
+    bool cas_sent = false;
+    bool lock_fallback = false;
+    std::vector<std::string> cas_keys;
+
+    // write-behind: pending keys are held since t_dirty until the flush is due
+    bool dirty = false;
+    rclcpp::Time t_dirty;
+
+    bool manager_reads_zstd = false;  // as advertised in the manager's last message
+    uint32_t epoch = 0;  // of the manager, as seen in its last message
+
+    // SYNC is sent again until the snapshot arrives on the reply topic
+    bool synced = false;
+    rclcpp::Time t_last_sync;
+  };
+
+  // what the handler last saw of a key: the blackboard is compared with the fingerprint
+  // of its value instead of a copy of it
+  struct KeyState
+  {
+    uint64_t fingerprint = 0;
+    uint64_t version = 0;  // last version seen
+    uint8_t type = TypeRegistry::UNSUPPORTED;  // UNSUPPORTED = no value seen yet
+  };
+
+  void blackboard_callback(bf_msgs::msg::Blackboard::UniquePtr msg, Shard & shard);
+  void heartbeat_callback(bf_msgs::msg::Blackboard::UniquePtr msg, Shard & shard);
   void control_cycle();
-  void update_blackboard();
+  void update_blackboard(Shard & shard);
+  void compare_and_swap(Shard & shard);
+  void send(Shard & shard, bf_msgs::msg::Blackboard & msg);
   void cache_blackboard();
   bool has_bb_changed();
+  void take_writes();
+  bool flush_due(Shard & shard, const rclcpp::Time & now);
+  bool excluded(const std::string & key);
+  bool remember(const std::string & key);
+  void new_epoch(Shard & shard, uint32_t epoch);
+  void forget_versions(const Shard & shard);
   void dump_data();
-  void sync_bb();
+  void sync_bb(Shard & shard);
 
 
-  BT::Blackboard::Ptr blackboard_, bb_cache_;
+  BT::Blackboard::Ptr blackboard_;
   std::string robot_id_;
-  std::vector<std::string> excluded_keys_;
-  bool access_granted_, request_sent_;
-  rclcpp::Time t_last_request_;
-
-  rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr bb_pub_;
-  rclcpp::Subscription<bf_msgs::msg::Blackboard>::SharedPtr bb_sub_;
+  // keys kept out of sharing: exclude_keys_ and, if given, the keys outside include_keys_.
+  // The rules' verdict on every key seen is kept, so they are evaluated once per key
+  KeyFilter exclude_keys_, include_keys_;
+  std::unordered_map<std::string, bool> excluded_keys_;
+  std::unordered_map<std::string, KeyState> key_states_;
+
+  ShardMap shard_map_;
+  std::vector<Shard> shards_;
+  bool optimistic_writes_;
+  int priority_, deadline_ms_;  // scheduling hints sent with every REQUEST
+  // pending keys are sent once flush_interval_ has passed since the first one changed or
+  // flush_max_keys_ are pending (interval 0 = send at once, 0 keys = no limit)
+  std::chrono::milliseconds flush_interval_;
+  int flush_max_keys_;
+  KeyFilter interest_;  // keys this robot receives (empty = every key)
+  PayloadCodec codec_;  // compression of large UPDATE and CAS messages
 
   rclcpp::TimerBase::SharedPtr timer_;
 
+  // dirty tracking: keys notified since the last cycle; the blackboard is only compared
+  // with key_states_ on request or every scan_period_ (0 = on request only)
+  std::mutex writes_mutex_;
+  std::unordered_set<std::string> written_keys_;
+  std::atomic<bool> scan_requested_;
+  std::chrono::milliseconds scan_period_;
+  rclcpp::Time t_last_scan_;
+
   bool sync_rcvd_;
 
   // test stuff
   rclcpp::Time waiting_time_;
-  double avg_waiting_time_;
-  int n_success_, n_requests_, n_updates_;
+  double avg_waiting_time_, total_grant_wait_;  // millis
+  int n_success_, n_requests_, n_updates_, n_grants_;
 };
 
 }   // namespace BF
@@ -16,16 +16,36 @@
 #define BEHAVIORFLEETS__BLACKBOARDMANAGER_HPP_
 
 #include <string>
-#include <queue>
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "behaviortree_cpp/blackboard.h"
 
 #include "bf_msgs/msg/blackboard.hpp"
+#include "bf_msgs/msg/blackboard_stats.hpp"
+
+#include "behaviorfleets/BlackboardStore.hpp"
+#include "behaviorfleets/GrantScheduler.hpp"
+#include "behaviorfleets/KeyFilter.hpp"
+#include "behaviorfleets/LatencyHistogram.hpp"
+#include "behaviorfleets/MpscQueue.hpp"
+#include "behaviorfleets/PayloadCodec.hpp"
+#include "behaviorfleets/ShardMap.hpp"
+#include "behaviorfleets/Trace.hpp"
+#include "behaviorfleets/TypeRegistry.hpp"
 
 #include "rclcpp/rclcpp.hpp"
 
@@ -46,39 +66,196 @@ public:
     BT::Blackboard::Ptr blackboard, std::chrono::milliseconds milis,
     std::chrono::milliseconds bb_refresh_rate,
     int msq_size);
+  virtual ~BlackboardManager();
 
 private:
+  using WriteRequest = GrantScheduler::Request;
+
+  // keys granted to a robot until it sends its UPDATE
+  struct Lease
+  {
+    std::vector<std::string> keys;
+    rclcpp::Time t_grant;
+    uint64_t token;
+  };
+
+  // messages handled since the last summary log
+  struct Counters
+  {
+    int requests = 0;
+    int grants = 0;
+    int updates = 0;  // UPDATEs and committed CAS
+    int rejected = 0;  // fenced UPDATEs and CAS conflicts
+    int publications = 0;
+  };
+
+  // message waiting for the publish thread
+  struct Publication
+  {
+    rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr pub;
+    bf_msgs::msg::Blackboard::UniquePtr msg;
+    bool compress;  // every subscriber reads the codec's payloads
+  };
+
+  // lock hold time accounting of a robot (seconds)
+  struct HoldStats
+  {
+    int n_leases = 0;
+    int n_revoked = 0;
+    double total = 0.0;
+    double max = 0.0;
+  };
+
+  std::function<void()> with_state(void (BlackboardManager::* callback)());
+  void enqueue(bf_msgs::msg::Blackboard::UniquePtr msg);
+  void commit_loop();
+  void publish_loop();
+  void publish(
+    bf_msgs::msg::Blackboard::UniquePtr msg,
+    const rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr & pub,
+    bool compress = false);
+  bool reads_payloads(const std::string & robot_id) const;
+  bool compress_data() const;
   void blackboard_callback(bf_msgs::msg::Blackboard::UniquePtr msg);
   void copy_blackboard(BT::Blackboard::Ptr source_bb);
-  std::string get_type(const char * port_name);
-  std::string get_type(BT::Blackboard::Ptr bb, const char * port_name);
+  bool is_shared(const std::string & key) const;
   void init();
   void control_cycle();
-  void grant_blackboard();
+  void dispatch_grants();
+  void grant_blackboard(const WriteRequest & request);
+  bool is_free(const WriteRequest & request);
+  void release_lease(const std::string & robot_id, bool revoked = false);
+  void expire_leases();
+  void deny(
+    const std::string & robot_id, uint64_t token,
+    const std::vector<std::string> & keys);
   void update_blackboard();
+  void compare_and_swap();
+  void commit(const std::string & robot_id);
   void publish_blackboard();
+  void encode_entries(const std::vector<std::string> & keys, bf_msgs::msg::Blackboard & msg);
+  void register_interest(const bf_msgs::msg::Blackboard & sync);
+  void serve_sync(const std::string & robot_id);
+  void publish_interests(
+    const bf_msgs::msg::Blackboard & msg,
+    const std::unordered_map<std::string, std::string> & changed);
+  void publish_stats();
+  void log_summary();
+  rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr reply_pub(const std::string & robot_id);
+  void reply(bf_msgs::msg::Blackboard & msg);
+  void mark_dirty(const std::string & key, const std::string & writer = "");
+  void recover_blackboard(const std::string & dir, bool sync);
+  void log_writes();
+  void checkpoint_blackboard();
+  void set_role(bool standby);
+  void heartbeat();
+  void heartbeat_callback(bf_msgs::msg::Blackboard::UniquePtr msg);
+  void step_down(const bf_msgs::msg::Blackboard & heartbeat);
+  void follow_primary(bf_msgs::msg::Blackboard::UniquePtr msg);
+  void take_over();
+  void new_epoch();
   void dump_blackboard();
   void dump_waiting_times();
+  void dump_hold_times();
 
   bf_msgs::msg::Blackboard::UniquePtr update_bb_msg_;
   BT::Blackboard::Ptr blackboard_;
-  bool lock_;
-  std::string robot_id_;
-  std::queue<std::string> q_;
+  std::string robot_id_;  // writer of the next delta ("" if there are several)
+  GrantScheduler scheduler_;  // pending write requests
   int msq_size_;
 
-  rclcpp::Time t_last_grant_;
+  // granted leases per robot, owner of every leased key
+  std::unordered_map<std::string, Lease> leases_;
+  std::unordered_map<std::string, std::string> key_owners_;
+  int n_whole_leases_;
+  uint64_t token_;  // fencing token of the last grant
+
+  // a lease is revoked after lease_timeout_, or after preempt_timeout_ if
+  // another robot is waiting for its keys (seconds, 0 disables preemption)
+  double lease_timeout_, preempt_timeout_;
+  std::unordered_map<std::string, HoldStats> hold_stats_;
+
+  // requests come in on one topic, answers go to the requester's reply topic
+  // and the blackboard contents are broadcast on the data topic
+  rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr data_pub_;
+  std::unordered_map<std::string,
+    rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr> reply_pubs_;
+  rclcpp::Subscription<bf_msgs::msg::Blackboard>::SharedPtr requests_sub_;
 
-  rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr bb_pub_;
-  rclcpp::Subscription<bf_msgs::msg::Blackboard>::SharedPtr bb_sub_;
+  // robots that only want some keys (sent with their SYNC) get them on their reply topic
+  // instead of the data topic
+  std::unordered_map<std::string, KeyFilter> interests_;
+
+  // publications above compression_threshold go compressed to robots that read them, as
+  // negotiated in their last SYNC (robot -> reads zstd); see compress_data()
+  PayloadCodec codec_;
+  std::unordered_map<std::string, bool> zstd_readers_;
 
   rclcpp::TimerBase::SharedPtr timer_publish_, timer_cycle_;
 
-  std::queue<rclcpp::Time> q_start_wait_;
-  std::vector<rclcpp::Duration> waiting_times_;
+  // threading: the requests subscription (ingest group, mutually exclusive, so the queue has a
+  // single producer) only queues the messages, in order. The commit thread applies them under
+  // state_mutex_, at most COMMIT_BATCH per lock, which the timers and the manager links
+  // (state group) also take, and queues the publications for the publish thread
+  static constexpr size_t COMMIT_BATCH = 64;
+  rclcpp::CallbackGroup::SharedPtr ingest_group_, state_group_;
+  MpscQueue<bf_msgs::msg::Blackboard::UniquePtr> requests_;
+  MpscQueue<Publication> publications_;
+  std::mutex state_mutex_, wake_mutex_;
+  std::condition_variable commit_cv_, publish_cv_;
+  std::atomic<bool> running_;
+  std::thread commit_thread_, publish_thread_;
+
+  // group commit: writes are published together once commit_window_ has passed since
+  // the first one or commit_batch_size_ writes are pending (window 0 = publish each write)
+  std::chrono::milliseconds commit_window_;
+  int commit_batch_size_, n_commits_;
+  rclcpp::TimerBase::SharedPtr timer_commit_;
+
+  // latency histograms since the last stats message, and grant waits since the start
+  LatencyHistogram grant_wait_, hold_time_, apply_time_, publish_time_, grant_wait_total_;
+  LatencyHistogram compress_time_;
+  uint64_t n_compressed_, raw_bytes_, compressed_bytes_;
+  std::mutex stats_mutex_;  // the publish thread writes publish_time_ and the compression stats
+  rclcpp::Publisher<bf_msgs::msg::BlackboardStats>::SharedPtr stats_pub_;
+  rclcpp::TimerBase::SharedPtr timer_stats_;
+  rclcpp::Time t_last_stats_;
   int tam_q_, n_pub_;
+  Counters counters_;
+  rclcpp::TimerBase::SharedPtr timer_summary_;
+
+  // keys served by this manager when the blackboard is sharded
+  ShardMap shard_map_;
+  int shard_id_;
+
+  // keys of the initial blackboard left out of sharing
+  KeyFilter exclude_keys_, include_keys_;
+
+  // per-key versions and keys changed since the last publication, with the robot that
+  // wrote each one ("" for the manager itself). Versions are (epoch_ << 32) + counter
+  std::unordered_map<std::string, uint64_t> versions_;
+  std::unordered_map<std::string, std::string> dirty_keys_;
+  uint64_t version_;
+  uint32_t epoch_;  // a standby takes the primary's one
+
+  // write-ahead log and checkpoints (persistence_dir), keys written since the last record
+  BlackboardStore store_;
+  std::vector<std::string> wal_keys_;
+  int n_wal_records_;  // records in the log since the last checkpoint
+  rclcpp::TimerBase::SharedPtr timer_checkpoint_;
 
-  bool sync_;
+  // replication: a standby follows the log shipped by the primary, serves SYNC and takes
+  // over when the primary's heartbeats stop for failover_timeout_ (seconds). The primary
+  // ships its log once it knows a standby (standby_name_), and the standby asks for its
+  // snapshot only once the primary's heartbeat names it, so no write falls in between
+  bool standby_, synced_, known_to_primary_;
+  double failover_timeout_;
+  rclcpp::Time t_primary_hb_, t_standby_hb_;
+  std::string standby_name_;
+  rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr heartbeat_pub_, log_pub_, sync_pub_;
+  rclcpp::Subscription<bf_msgs::msg::Blackboard>::SharedPtr heartbeat_sub_, log_sub_;
+  rclcpp::Subscription<bf_msgs::msg::Blackboard>::SharedPtr reply_sub_;
+  rclcpp::TimerBase::SharedPtr timer_heartbeat_;
 };
 
 }  // namespace BF
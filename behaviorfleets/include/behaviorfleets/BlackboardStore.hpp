@@ -0,0 +1,65 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__BLACKBOARDSTORE_HPP_
+#define BEHAVIORFLEETS__BLACKBOARDSTORE_HPP_
+
+#include <functional>
+#include <string>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "bf_msgs/msg/blackboard.hpp"
+
+namespace BF
+{
+
+// Persistence of the shared blackboard: an append-only write-ahead log of the committed
+// entries plus a compact checkpoint of the whole blackboard. Both hold serialized
+// bf_msgs/Blackboard records prefixed by their length and CRC-32; the checkpoint is written
+// and read through mmap and replaced atomically (rename), after which the log starts over.
+class BlackboardStore
+{
+public:
+  BlackboardStore();
+  ~BlackboardStore();
+
+  // opens (creating it if needed) the store in dir. With sync, append() returns once the
+  // record is on disk (fdatasync); without it, a crash of the host may lose the last ones
+  bool open(const std::string & dir, bool sync = true);
+  bool is_open() const {return wal_fd_ >= 0;}
+
+  // replays the checkpoint and then the log, calling apply for every record in order.
+  // Returns the number of records; replay stops at the first torn or corrupted record
+  size_t recover(const std::function<void(const bf_msgs::msg::Blackboard &)> & apply);
+
+  // appends a record to the log
+  bool append(const bf_msgs::msg::Blackboard & record);
+  // replaces the checkpoint with snapshot and, once it is on disk, truncates the log
+  bool checkpoint(const bf_msgs::msg::Blackboard & snapshot);
+
+private:
+  size_t replay(
+    const std::string & path,
+    const std::function<void(const bf_msgs::msg::Blackboard &)> & apply);
+
+  std::string dir_, wal_path_, checkpoint_path_;
+  int wal_fd_;
+  bool sync_;
+  rclcpp::Serialization<bf_msgs::msg::Blackboard> serializer_;
+};
+
+}  // namespace BF
+
+#endif  // BEHAVIORFLEETS__BLACKBOARDSTORE_HPP_
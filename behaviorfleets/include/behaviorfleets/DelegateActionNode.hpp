@@ -31,6 +31,8 @@
 
 #include "bf_msgs/msg/mission.hpp"
 
+#include "behaviorfleets/Trace.hpp"
+
 #include "rclcpp/rclcpp.hpp"
 
 namespace BF
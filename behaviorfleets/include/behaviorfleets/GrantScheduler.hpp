@@ -0,0 +1,90 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__GRANTSCHEDULER_HPP_
+#define BEHAVIORFLEETS__GRANTSCHEDULER_HPP_
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+
+namespace BF
+{
+
+// Pending write requests of the blackboard manager and the order they are granted in:
+// priority first, then earliest deadline, then weighted fair share among robots
+// (stride scheduling: each grant advances the robot's pass by 1 / weight).
+// A robot has at most one pending request; a repeated REQUEST is merged into it.
+// The requests are kept sorted in grant order, indexed by robot.
+class GrantScheduler
+{
+public:
+  // pending write request: keys the robot intends to write (empty = whole blackboard)
+  struct Request
+  {
+    std::string robot_id;
+    std::vector<std::string> keys;
+    rclcpp::Time t_start;
+    uint8_t priority = 0;
+    rclcpp::Time deadline;  // 0 = no deadline
+    uint64_t seq = 0;  // arrival order
+    double pass = 0.0;  // virtual time of the robot when it was queued
+  };
+
+  // grant order: priority, then requests with a deadline (earliest first), then pass and
+  // arrival. A strict total order, since seq is unique
+  struct Order
+  {
+    bool operator()(const Request & a, const Request & b) const;
+  };
+  using Queue = std::set<Request, Order>;
+
+  // weight_rules: "robot_id=weight" entries; robots without a rule weigh 1
+  explicit GrantScheduler(const std::vector<std::string> & weight_rules = {});
+
+  // queues the request, or merges it into the one the robot already has queued (false)
+  bool push(const Request & request);
+  // pending requests in grant order
+  const Queue & ordered() const {return q_;}
+  // pending request of a robot (nullptr if none)
+  const Request * find(const std::string & robot_id) const;
+  // removes the request of a robot that has been granted
+  void pop(const std::string & robot_id);
+  // drops every pending request (fair share history is kept)
+  void clear()
+  {
+    q_.clear();
+    index_.clear();
+  }
+
+  size_t size() const {return q_.size();}
+  bool empty() const {return q_.empty();}
+  double weight(const std::string & robot_id) const;
+  size_t n_weights() const {return weights_.size();}
+
+private:
+  Queue q_;
+  std::unordered_map<std::string, Queue::iterator> index_;  // request of each robot
+  std::unordered_map<std::string, double> weights_;
+  std::unordered_map<std::string, double> pass_;  // next pass of each robot
+  double vtime_;  // pass of the last grant
+  uint64_t seq_;
+};
+
+}  // namespace BF
+
+#endif  // BEHAVIORFLEETS__GRANTSCHEDULER_HPP_
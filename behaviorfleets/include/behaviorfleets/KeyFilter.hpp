@@ -0,0 +1,55 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__KEYFILTER_HPP_
+#define BEHAVIORFLEETS__KEYFILTER_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace BF
+{
+
+// Set of blackboard keys given by rules: an exact key ("robot_pose"), a prefix
+// ending in '*' ("nav/*") or a glob with '*' and '?' anywhere ("*efbb_*"). Empty
+// rules are ignored. The rules are compiled once: an exact key is one hash lookup and
+// prefixes one per distinct prefix length, hashing a view of the key's head instead of a
+// copy of it. Only globs are matched one by one.
+class KeyFilter
+{
+public:
+  explicit KeyFilter(const std::vector<std::string> & rules = {});
+
+  // true if the key matches any rule
+  bool matches(const std::string & key) const;
+  // no rules: nothing matches
+  bool empty() const {return rules_.empty();}
+  // accepted rules, as given
+  const std::vector<std::string> & rules() const {return rules_;}
+
+private:
+  static bool glob_match(const std::string & glob, const std::string & key);
+
+  std::vector<std::string> rules_;
+  std::unordered_set<std::string> keys_;
+  std::unordered_multimap<size_t, std::string> prefixes_;  // hash of the prefix -> prefix
+  std::vector<size_t> prefix_lengths_;
+  std::vector<std::string> globs_;
+};
+
+}  // namespace BF
+
+#endif  // BEHAVIORFLEETS__KEYFILTER_HPP_
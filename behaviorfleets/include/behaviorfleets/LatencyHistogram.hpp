@@ -0,0 +1,62 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__LATENCYHISTOGRAM_HPP_
+#define BEHAVIORFLEETS__LATENCYHISTOGRAM_HPP_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+namespace BF
+{
+
+// Fixed-memory latency histogram (HDR style). Values are counted in microseconds in
+// log-linear buckets: exact below 32 us, and 32 buckets per power of two above, so any
+// value is known within ~3 %. Values above ~2^45 us are counted in the last bucket.
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void record(double seconds);
+  void reset();
+
+  uint64_t count() const {return count_;}
+  // seconds
+  double mean() const;
+  double max() const {return max_us_ / 1e6;}
+  double percentile(double p) const;
+
+  // calls f(seconds, count) for every non empty bucket, with the bucket midpoint
+  void for_each(const std::function<void(double, uint64_t)> & f) const;
+
+private:
+  static constexpr int SUB_BITS = 5;
+  static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+  static constexpr int MAX_SHIFT = 40;
+  static constexpr size_t N_BUCKETS = (MAX_SHIFT + 2) * SUB_BUCKETS;
+
+  static size_t index(uint64_t us);
+  static uint64_t lowest(size_t index);
+  static uint64_t width(size_t index);
+
+  std::array<uint64_t, N_BUCKETS> counts_;
+  uint64_t count_, max_us_;
+  double sum_us_;
+};
+
+}  // namespace BF
+
+#endif  // BEHAVIORFLEETS__LATENCYHISTOGRAM_HPP_
@@ -0,0 +1,83 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__MPSCQUEUE_HPP_
+#define BEHAVIORFLEETS__MPSCQUEUE_HPP_
+
+#include <atomic>
+#include <utility>
+
+namespace BF
+{
+
+// Unbounded lock-free queue with many producers and a single consumer (Vyukov's
+// intrusive MPSC queue). push() may be called from any thread; pop() and empty() only
+// from the consumer thread.
+template<typename T>
+class MpscQueue
+{
+public:
+  MpscQueue()
+  : head_(new Node), tail_(head_.load())
+  {
+  }
+
+  ~MpscQueue()
+  {
+    T item;
+    while (pop(item)) {
+    }
+    delete tail_;
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue & operator=(const MpscQueue &) = delete;
+
+  void push(T item)
+  {
+    Node * node = new Node;
+    node->item = std::move(item);
+    Node * prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // false if the queue is empty, or if the next item is still being pushed
+  bool pop(T & item)
+  {
+    Node * next = tail_->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return false;
+    }
+    item = std::move(next->item);
+    delete tail_;
+    tail_ = next;  // the popped node becomes the new stub
+    return true;
+  }
+
+  bool empty() const {return tail_->next.load(std::memory_order_acquire) == nullptr;}
+
+private:
+  struct Node
+  {
+    std::atomic<Node *> next{nullptr};
+    T item{};
+  };
+
+  std::atomic<Node *> head_;  // last pushed node
+  Node * tail_;  // stub node, followed by the next item to pop
+};
+
+}  // namespace BF
+
+#endif  // BEHAVIORFLEETS__MPSCQUEUE_HPP_
@@ -0,0 +1,70 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__PAYLOADCODEC_HPP_
+#define BEHAVIORFLEETS__PAYLOADCODEC_HPP_
+
+#include <zstd.h>
+
+#include <memory>
+#include <string>
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "bf_msgs/msg/blackboard.hpp"
+
+namespace BF
+{
+
+// Optional zstd compression of the entries of a blackboard message. Above a size
+// threshold the entries are serialized and compressed into the payload field, with a
+// shared dictionary if one is given. Every node advertises in its messages that it reads
+// zstd with its dictionary, and only compresses for peers that advertised the same one.
+// Safe to use from several threads.
+class PayloadCodec
+{
+public:
+  // threshold: approximate size of the entries (bytes) from which they are compressed
+  // (0 = never). dictionary: file trained with `zstd --train` ("" = none)
+  explicit PayloadCodec(
+    size_t threshold = 0, const std::string & dictionary = "", int level = 3);
+
+  bool enabled() const {return threshold_ > 0;}
+  // a dictionary was given but could not be loaded (compression is then disabled)
+  bool dictionary_failed() const {return dictionary_failed_;}
+  uint32_t dictionary_id() const {return dictionary_id_;}
+
+  // marks msg as sent by a node that reads this codec's payloads
+  void advertise(bf_msgs::msg::Blackboard & msg) const;
+  // true if the sender of msg can read this codec's payloads
+  bool readable_by(const bf_msgs::msg::Blackboard & msg) const;
+
+  // moves the entries of msg into a compressed payload if they are above the threshold;
+  // returns the size of the serialized entries (0 if msg was left as is)
+  size_t compress(bf_msgs::msg::Blackboard & msg) const;
+  // restores the entries of a compressed msg; false if it cannot be decoded
+  bool decompress(bf_msgs::msg::Blackboard & msg) const;
+
+private:
+  size_t threshold_;
+  int level_;
+  bool dictionary_failed_;
+  uint32_t dictionary_id_;
+  std::shared_ptr<ZSTD_CDict> cdict_;
+  std::shared_ptr<ZSTD_DDict> ddict_;
+};
+
+}  // namespace BF
+
+#endif  // BEHAVIORFLEETS__PAYLOADCODEC_HPP_
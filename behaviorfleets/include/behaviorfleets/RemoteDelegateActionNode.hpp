@@ -18,6 +18,7 @@
 #include <string>
 #include <iostream>
 #include <random>
+#include <vector>
 
 #include "rclcpp/rclcpp.hpp"
 
@@ -30,6 +31,7 @@
 #include "bf_msgs/msg/mission_status.hpp"
 
 #include "behaviorfleets/BlackboardHandler.hpp"
+#include "behaviorfleets/Trace.hpp"
 
 namespace BF
 {
@@ -45,6 +47,7 @@ private:
   void mission_callback(bf_msgs::msg::Mission::UniquePtr msg);
   void mission_poll_callback(bf_msgs::msg::Mission::UniquePtr msg);
   bool create_tree();
+  void watch_tree(const BT::Blackboard::Ptr & blackboard);
   void control_cycle();
   void init();
 
@@ -64,6 +67,10 @@ private:
   BF::BlackboardHandler::SharedPtr bb_handler_;
 
   BT::Tree tree_;
+  // keys written by the output ports of the tree, notified to bb_handler_ after every tick.
+  // Nodes that write other keys (scripts, subtrees) make it compare the whole blackboard
+  std::vector<std::string> output_keys_;
+  bool scan_after_tick_ = false;
   rclcpp::TimerBase::SharedPtr timer_;
 
   rclcpp::Node::SharedPtr node_;  // new
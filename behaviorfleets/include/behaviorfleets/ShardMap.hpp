@@ -0,0 +1,67 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__SHARDMAP_HPP_
+#define BEHAVIORFLEETS__SHARDMAP_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace BF
+{
+
+// Partition of the blackboard keys among several blackboard managers. Each
+// shard is served by its own manager on its own topic; keys are assigned by
+// prefix rules ("prefix=shard", longest match first) or else by hash.
+class ShardMap
+{
+public:
+  explicit ShardMap(int shards = 1, const std::vector<std::string> & prefix_rules = {});
+
+  int shards() const {return shards_;}
+  // shard that owns the key
+  int shard(const std::string & key) const;
+  // base name of the topics of a shard; a single shard keeps the plain "/blackboard"
+  std::string topic(int shard) const;
+  // handlers -> manager: REQUEST, UPDATE, CAS and SYNC
+  std::string requests_topic(int shard) const {return topic(shard) + "/requests";}
+  // manager -> one robot: GRANT, DENY, ACK and CONFLICT (and PUBLISH with an interest set).
+  // The robot_id must be valid_robot_id(), or the name is not a valid topic
+  std::string reply_topic(int shard, const std::string & robot_id) const
+  {
+    return topic(shard) + "/" + robot_id + "/reply";
+  }
+  // manager -> every robot: PUBLISH
+  std::string data_topic(int shard) const {return topic(shard) + "/data";}
+  // primary <-> standby managers: HEARTBEAT, and the log of committed entries
+  std::string heartbeat_topic(int shard) const {return topic(shard) + "/heartbeat";}
+  std::string log_topic(int shard) const {return topic(shard) + "/log";}
+  // manager -> operators: BlackboardStats
+  std::string stats_topic(int shard) const {return topic(shard) + "/stats";}
+  // prefix rules that were accepted
+  size_t n_rules() const {return prefixes_.size();}
+
+  // robot ids are one token of a topic name: letters, digits and '_', not starting with a
+  // digit (as node names)
+  static bool valid_robot_id(const std::string & robot_id);
+
+private:
+  int shards_;
+  std::vector<std::pair<std::string, int>> prefixes_;
+};
+
+}  // namespace BF
+
+#endif  // BEHAVIORFLEETS__SHARDMAP_HPP_
@@ -0,0 +1,31 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__TRACE_HPP_
+#define BEHAVIORFLEETS__TRACE_HPP_
+
+#include "rclcpp/logging.hpp"
+
+// Per-message logs of the hot paths (every request, grant, update, publication and tick).
+// They take a printf-style format and its arguments, so nothing is formatted or allocated
+// unless the message is logged. They are compiled in only when the package is built with
+// -DBF_TRACE=ON, and then logged at DEBUG level (--ros-args --log-level debug). Otherwise
+// they expand to nothing and their arguments are not evaluated.
+#ifdef BF_ENABLE_TRACE
+#define BF_TRACE(logger, ...) RCLCPP_DEBUG(logger, __VA_ARGS__)
+#else
+#define BF_TRACE(logger, ...) do {} while (0)
+#endif
+
+#endif  // BEHAVIORFLEETS__TRACE_HPP_
@@ -0,0 +1,160 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BEHAVIORFLEETS__TYPEREGISTRY_HPP_
+#define BEHAVIORFLEETS__TYPEREGISTRY_HPP_
+
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <shared_mutex>
+#include <vector>
+
+#include "behaviortree_cpp/blackboard.h"
+
+#include "bf_msgs/msg/blackboard_entry.hpp"
+
+namespace BF
+{
+
+// value of a CUSTOM type that is not registered on this node (e.g. in the manager):
+// kept and forwarded as the bytes it was received with
+struct OpaqueValue
+{
+  std::string type_name;
+  std::vector<uint8_t> bytes;
+};
+
+// Maps the C++ type of every blackboard entry to its wire type tag
+// (bf_msgs::msg::BlackboardEntry) and reads/writes values through the exact
+// type, so no demangling nor exceptions are involved per key.
+class TypeRegistry
+{
+public:
+  static constexpr uint8_t UNSUPPORTED = 0xFF;
+
+  static TypeRegistry & instance();
+
+  // type tag of a C++ type; resolved once and cached
+  uint8_t tag(const std::type_index & type);
+  // type tag of the entry stored under key (UNSUPPORTED if it does not exist)
+  uint8_t tag(const BT::Blackboard::Ptr & bb, const std::string & key);
+
+  // reads key from bb into entry; false if the key is missing, empty or unsupported
+  bool encode(
+    const BT::Blackboard::Ptr & bb, const std::string & key,
+    bf_msgs::msg::BlackboardEntry * entry);
+  // writes entry into bb, keeping the C++ type of the key if it already exists
+  bool decode(const bf_msgs::msg::BlackboardEntry & entry, const BT::Blackboard::Ptr & bb);
+
+  // shares values of type T as CUSTOM entries named type_name. Every robot that reads
+  // them must register the same name for the same type, before its handler is created;
+  // nodes that do not register it (the manager) keep the values as OpaqueValue
+  template<typename T>
+  void register_type(
+    const std::string & type_name,
+    std::function<void(const T & value, std::vector<uint8_t> * bytes)> serialize,
+    std::function<bool(const std::vector<uint8_t> & bytes, T * value)> deserialize);
+
+  // register_type with a raw binary copy, for trivially copyable structs (all robots
+  // must share the same layout and endianness)
+  template<typename T>
+  void register_trivial(const std::string & type_name);
+
+private:
+  // how values of a C++ type are read from / written to the blackboard
+  struct Visitor
+  {
+    uint8_t tag;
+    std::string type_name;  // CUSTOM only
+    std::function<void(const BT::Any & value, bf_msgs::msg::BlackboardEntry * entry)> read;
+    std::function<bool(
+        const bf_msgs::msg::BlackboardEntry & entry, const BT::Blackboard::Ptr & bb)> write;
+  };
+
+  TypeRegistry();
+  template<typename T>
+  void add(uint8_t tag, bool default_for_tag = false);
+  void add_custom(const std::type_index & type, Visitor visitor);
+  std::optional<Visitor> find(const std::type_index & type);
+  std::optional<Visitor> find_custom(const std::string & type_name);
+
+  std::shared_mutex mutex_;
+  std::unordered_map<std::type_index, Visitor> visitors_;
+  std::unordered_map<std::type_index, uint8_t> tags_;  // cache, including unsupported types
+  std::unordered_map<uint8_t, Visitor> defaults_;  // visitor used for new keys of each tag
+  std::unordered_map<std::string, std::type_index> customs_;  // registered CUSTOM types
+};
+
+template<typename T>
+void TypeRegistry::register_type(
+  const std::string & type_name,
+  std::function<void(const T & value, std::vector<uint8_t> * bytes)> serialize,
+  std::function<bool(const std::vector<uint8_t> & bytes, T * value)> deserialize)
+{
+  Visitor visitor;
+  visitor.tag = bf_msgs::msg::BlackboardEntry::CUSTOM;
+  visitor.type_name = type_name;
+  visitor.read = [type_name, serialize](
+    const BT::Any & value, bf_msgs::msg::BlackboardEntry * entry) {
+      entry->type_name = type_name;
+      serialize(value.cast<T>(), &entry->bytes_value);
+    };
+  visitor.write = [deserialize](
+    const bf_msgs::msg::BlackboardEntry & entry, const BT::Blackboard::Ptr & bb) {
+      T value;
+      if (!deserialize(entry.bytes_value, &value)) {
+        return false;
+      }
+      bb->set(entry.key, value);
+      return true;
+    };
+  add_custom(typeid(T), std::move(visitor));
+}
+
+template<typename T>
+void TypeRegistry::register_trivial(const std::string & type_name)
+{
+  static_assert(std::is_trivially_copyable_v<T>, "register_type() needs serializers");
+  register_type<T>(
+    type_name,
+    [](const T & value, std::vector<uint8_t> * bytes) {
+      bytes->resize(sizeof(T));
+      std::memcpy(bytes->data(), &value, sizeof(T));
+    },
+    [](const std::vector<uint8_t> & bytes, T * value) {
+      if (bytes.size() != sizeof(T)) {
+        return false;
+      }
+      std::memcpy(value, bytes.data(), sizeof(T));
+      return true;
+    });
+}
+
+// true if both entries carry the same type and value (keys and versions are ignored)
+bool same_value(
+  const bf_msgs::msg::BlackboardEntry & a,
+  const bf_msgs::msg::BlackboardEntry & b);
+
+// 64-bit hash of the type and value of an entry (keys and versions are ignored), so a
+// value can be told apart from the previous one without keeping a copy of it
+uint64_t fingerprint(const bf_msgs::msg::BlackboardEntry & entry);
+
+}  // namespace BF
+
+#endif  // BEHAVIORFLEETS__TYPEREGISTRY_HPP_
@@ -25,6 +25,7 @@
 #include "rclcpp/rclcpp.hpp"
 
 #include "behaviorfleets/BlackboardHandler.hpp"
+#include "behaviorfleets/Trace.hpp"
 
 #include "behaviortree_cpp/blackboard.h"
 
@@ -0,0 +1,81 @@
+# Copyright 2023 Rodrigo Pérez-Rodríguez
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+import os
+
+from ament_index_python.packages import get_package_share_directory
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, OpaqueFunction
+from launch.substitutions import LaunchConfiguration
+from launch_ros.actions import Node
+
+
+def launch_shards(context):
+    sp_dir = get_package_share_directory('behaviorfleets')
+
+    params = os.path.join(
+        sp_dir,
+        'params',
+        'blackboard_params.yaml'
+    )
+
+    shards = int(LaunchConfiguration('shards').perform(context))
+    test = LaunchConfiguration('test').perform(context)
+
+    # one blackboard manager per shard, each one on its own topic
+    actions = []
+    for shard_id in range(shards):
+        actions.append(Node(
+            package='behaviorfleets',
+            executable='bb_manager',
+            name='blackboard_manager_' + str(shard_id),
+            output='screen',
+            arguments=[test],
+            parameters=[params, {'shards': shards, 'shard_id': shard_id}]
+        ))
+
+    # the handlers of the stress test route every key to its shard
+    actions.append(Node(
+        package='behaviorfleets',
+        executable='bb_stress_test',
+        output='screen',
+        arguments=[test],
+        parameters=[params, {'shards': shards}]
+    ))
+
+    return actions
+
+
+def generate_launch_description():
+    shards_arg = DeclareLaunchArgument(
+        'shards',
+        default_value='2',
+        description='Number of blackboard managers the keys are partitioned among'
+    )
+
+    test_arg = DeclareLaunchArgument(
+        'test',
+        default_value='stress_tests/nodes/test_10.yaml',
+        description='Stress test configuration file (relative to params/)'
+    )
+
+    # Create the launch description and populate
+    ld = LaunchDescription()
+
+    ld.add_action(shards_arg)
+    ld.add_action(test_arg)
+    ld.add_action(OpaqueFunction(function=launch_shards))
+
+    return ld
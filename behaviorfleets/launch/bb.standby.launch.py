@@ -0,0 +1,77 @@
+# Copyright 2023 Rodrigo Pérez-Rodríguez
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import os
+
+from ament_index_python.packages import get_package_share_directory
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument
+from launch.substitutions import LaunchConfiguration
+from launch_ros.actions import Node
+
+
+def generate_launch_description():
+    # Get the launch directory
+    sp_dir = get_package_share_directory('behaviorfleets')
+
+    params = os.path.join(
+        sp_dir,
+        'params',
+        'blackboard_params.yaml'
+    )
+
+    test = LaunchConfiguration('test')
+
+    test_arg = DeclareLaunchArgument(
+        'test',
+        default_value='stress_tests/nodes/test_10.yaml',
+        description='Stress test configuration file (relative to params/)'
+    )
+
+    # kill the primary (e.g. pkill -f blackboard_manager_primary) to watch the standby take over
+    primary_cmd = Node(
+        package='behaviorfleets',
+        executable='bb_manager',
+        name='blackboard_manager_primary',
+        output='screen',
+        arguments=[test],
+        parameters=[params, {'role': 'primary'}]
+    )
+
+    standby_cmd = Node(
+        package='behaviorfleets',
+        executable='bb_manager',
+        name='blackboard_manager_standby',
+        output='screen',
+        arguments=[test],
+        parameters=[params, {'role': 'standby'}]
+    )
+
+    stress_cmd = Node(
+        package='behaviorfleets',
+        executable='bb_stress_test',
+        output='screen',
+        arguments=[test],
+        parameters=[params]
+    )
+
+    # Create the launch description and populate
+    ld = LaunchDescription()
+
+    ld.add_action(test_arg)
+    ld.add_action(primary_cmd)
+    ld.add_action(standby_cmd)
+    ld.add_action(stress_cmd)
+
+    return ld
@@ -21,31 +21,82 @@ BlackboardHandler::BlackboardHandler(
   const std::string robot_id,
   BT::Blackboard::Ptr blackboard)
 : Node(robot_id + "_blackboard_handler"),
-  robot_id_(robot_id),
   blackboard_(blackboard),
-  access_granted_(false),
-  request_sent_(false),
+  robot_id_(robot_id),
+  scan_requested_(false),
+  total_grant_wait_(0.0),
   n_success_(0),
   n_requests_(0),
-  n_updates_(0)
+  n_updates_(0),
+  n_grants_(0)
 {
   using namespace std::chrono_literals;
 
-  bb_cache_ = BT::Blackboard::create();
+  optimistic_writes_ = declare_parameter("optimistic_writes", false);
+  priority_ = declare_parameter("priority", 0);
+  if (priority_ < 0 || priority_ > 255) {
+    RCLCPP_ERROR(get_logger(), "priority %d out of range [0, 255], clamped", priority_);
+    priority_ = std::clamp(priority_, 0, 255);
+  }
+  deadline_ms_ = declare_parameter("deadline_ms", 0);
+  flush_interval_ = std::chrono::milliseconds(declare_parameter("flush_interval_ms", 0));
+  flush_max_keys_ = declare_parameter("flush_max_keys", 0);
+  interest_ = KeyFilter(declare_parameter("interest", std::vector<std::string>{}));
+  exclude_keys_ = KeyFilter(
+    declare_parameter("exclude_keys", std::vector<std::string>{"*efbb_*"}));
+  include_keys_ = KeyFilter(declare_parameter("include_keys", std::vector<std::string>{}));
+  scan_period_ = std::chrono::milliseconds(declare_parameter("scan_period_ms", 0));
+  t_last_scan_ = rclcpp::Clock().now();
+  codec_ = PayloadCodec(
+    declare_parameter("compression_threshold", 0),
+    declare_parameter("compression_dictionary", std::string("")),
+    declare_parameter("compression_level", 3));
+  if (codec_.dictionary_failed()) {
+    RCLCPP_ERROR(get_logger(), "cannot load the compression dictionary: compression disabled");
+  }
+
   cache_blackboard();
 
-  bb_pub_ = create_publisher<bf_msgs::msg::Blackboard>(
-    "/blackboard", 100);
+  // one connection per blackboard manager; keys are routed to the shard that owns them
+  shard_map_ = ShardMap(
+    declare_parameter("shards", 1),
+    declare_parameter("shard_prefixes", std::vector<std::string>{}));
+  shards_.resize(shard_map_.shards());
+  for (size_t i = 0; i < shards_.size(); i++) {
+    shards_[i].pub = create_publisher<bf_msgs::msg::Blackboard>(
+      shard_map_.requests_topic(i), 100);
 
-  bb_sub_ = create_subscription<bf_msgs::msg::Blackboard>(
-    "/blackboard", rclcpp::SensorDataQoS().keep_last(1000),
-    std::bind(&BlackboardHandler::blackboard_callback, this, std::placeholders::_1));
+    // reliable: deltas carry only the changed keys, a lost one would leave them diverged
+    shards_[i].reply_sub = create_subscription<bf_msgs::msg::Blackboard>(
+      shard_map_.reply_topic(i, robot_id_), 100,
+      std::bind(
+        &BlackboardHandler::blackboard_callback, this, std::placeholders::_1,
+        std::ref(shards_[i])));
+
+    // with an interest set, the manager sends the matching keys on the reply topic
+    if (interest_.empty()) {
+      shards_[i].data_sub = create_subscription<bf_msgs::msg::Blackboard>(
+        shard_map_.data_topic(i), 1000,
+        std::bind(
+          &BlackboardHandler::blackboard_callback, this, std::placeholders::_1,
+          std::ref(shards_[i])));
+    }
+
+    // a new epoch is noticed even when no data reaches this robot (e.g. in interest mode)
+    shards_[i].heartbeat_sub = create_subscription<bf_msgs::msg::Blackboard>(
+      shard_map_.heartbeat_topic(i), 10,
+      std::bind(
+        &BlackboardHandler::heartbeat_callback, this, std::placeholders::_1,
+        std::ref(shards_[i])));
+  }
 
   timer_ = create_wall_timer(1ms, std::bind(&BlackboardHandler::control_cycle, this));
 
   sync_rcvd_ = false;
 
-  sync_bb();
+  for (auto & shard : shards_) {
+    sync_bb(shard);
+  }
 
   // rclcpp::on_shutdown([this]() {dump_data();});
 }
@@ -69,230 +120,485 @@ void BlackboardHandler::dump_data()
     file << "requests:" << n_requests_ << std::endl;
     file << "success:" << n_success_ << std::endl;
     file << "updates:" << n_updates_ << std::endl;
+    file << "avg_grant_wt:" << (total_grant_wait_ / n_grants_) << std::endl;
     file.close();
   }
 }
 
 void BlackboardHandler::control_cycle()
 {
-  if (has_bb_changed()) {
-    update_blackboard();
-    cache_blackboard();
+  take_writes();
+
+  rclcpp::Time now = rclcpp::Clock().now();
+  bool scan_due = scan_period_.count() > 0 &&
+    now - t_last_scan_ >= rclcpp::Duration(scan_period_);
+  if (scan_requested_.exchange(false) || scan_due) {
+    t_last_scan_ = now;
+    has_bb_changed();
+  }
+
+  for (auto & shard : shards_) {
+    if (!shard.synced && (now - shard.t_last_sync).seconds() > 1.0) {
+      sync_bb(shard);  // the reply topic may not have been matched yet
+    }
+    if (shard.pending_keys.empty()) {
+      shard.dirty = false;
+      continue;
+    }
+    if (!flush_due(shard, now)) {
+      continue;
+    }
+    if (optimistic_writes_ && !shard.lock_fallback) {
+      compare_and_swap(shard);
+    } else {
+      update_blackboard(shard);
+    }
   }
   // old
   // dump_data();
 }
 
+bool BlackboardHandler::flush_due(Shard & shard, const rclcpp::Time & now)
+{
+  // until the flush is due, repeated writes to a key only update its value
+  if (!shard.dirty) {
+    shard.dirty = true;
+    shard.t_dirty = now;
+  }
+  if (flush_max_keys_ > 0 && shard.pending_keys.size() >= static_cast<size_t>(flush_max_keys_)) {
+    return true;
+  }
+  return now - shard.t_dirty >= rclcpp::Duration(flush_interval_);
+}
+
 bool BlackboardHandler::has_bb_changed()
 {
-  std::vector<BT::StringView> sv_bb = blackboard_->getKeys();
-  std::vector<BT::StringView> sv_cache_bb = bb_cache_->getKeys();
-
-  for (const auto & entry_bb : sv_bb) {
-    if (std::find(
-        excluded_keys_.begin(), excluded_keys_.end(),
-        entry_bb.data()) != excluded_keys_.end())
-    {
-      // the key is in the exclusion list
+  bool changed = false;
+
+  for (const auto & string_view : blackboard_->getKeys()) {
+    std::string key(string_view);
+    if (!excluded(key) && remember(key)) {
+      BF_TRACE(get_logger(), "key %s has changed", key.c_str());
+      shards_[shard_map_.shard(key)].pending_keys.insert(key);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void BlackboardHandler::notify_write(const std::string & key)
+{
+  std::lock_guard<std::mutex> lock(writes_mutex_);
+  written_keys_.insert(key);
+}
+
+void BlackboardHandler::request_scan()
+{
+  scan_requested_ = true;
+}
+
+void BlackboardHandler::take_writes()
+{
+  std::unordered_set<std::string> written;
+  {
+    std::lock_guard<std::mutex> lock(writes_mutex_);
+    written.swap(written_keys_);
+  }
+
+  for (const auto & key : written) {
+    if (excluded(key)) {
       continue;
     }
-    if (std::find(sv_cache_bb.begin(), sv_cache_bb.end(), entry_bb) == sv_cache_bb.end()) {
-      RCLCPP_DEBUG(get_logger(), "key %s not in cache", entry_bb.data());
-      return true;
-    } else if (blackboard_->get<std::string>(entry_bb.data()) !=
-      bb_cache_->get<std::string>(entry_bb.data()))
-    {
-      RCLCPP_DEBUG(get_logger(), "key %s has changed", entry_bb.data());
-      return true;
+    // a key written with the value it already had is not sent
+    if (remember(key)) {
+      shards_[shard_map_.shard(key)].pending_keys.insert(key);
     }
   }
-  return false;
 }
 
-void BlackboardHandler::blackboard_callback(bf_msgs::msg::Blackboard::UniquePtr msg)
+bool BlackboardHandler::excluded(const std::string & key)
+{
+  // the rules are evaluated once per key; the type is checked every time, since a key may
+  // have no value yet or a custom type registered later
+  auto verdict = excluded_keys_.find(key);
+  if (verdict == excluded_keys_.end()) {
+    bool left_out = exclude_keys_.matches(key) ||
+      (!include_keys_.empty() && !include_keys_.matches(key));
+    verdict = excluded_keys_.emplace(key, left_out).first;
+    if (left_out) {
+      BF_TRACE(get_logger(), "key %s excluded", key.c_str());
+    }
+  }
+  return verdict->second ||
+         TypeRegistry::instance().tag(blackboard_, key) == TypeRegistry::UNSUPPORTED;
+}
+
+void BlackboardHandler::blackboard_callback(
+  bf_msgs::msg::Blackboard::UniquePtr msg,
+  Shard & shard)
 {
-  RCLCPP_DEBUG(get_logger(), "blackboard_callback");
+  BF_TRACE(get_logger(), "blackboard_callback");
+  shard.manager_reads_zstd = codec_.readable_by(*msg);
+  if (!codec_.decompress(*msg)) {
+    RCLCPP_ERROR(get_logger(), "message dropped: its payload cannot be decompressed");
+    return;
+  }
+  if (msg->epoch != 0 && msg->epoch != shard.epoch) {
+    new_epoch(shard, msg->epoch);
+  }
+
   if ((msg->type == bf_msgs::msg::Blackboard::GRANT) && (msg->robot_id == robot_id_)) {
-    RCLCPP_DEBUG(get_logger(), "access to blackboard GRANTED");
-    access_granted_ = true;
-    update_blackboard();
+    BF_TRACE(get_logger(), "access to blackboard GRANTED (%zu keys)", msg->keys.size());
+    shard.access_granted = true;
+    shard.granted_keys = msg->keys;
+    shard.grant_token = msg->token;
+    // time the request waited in the manager queue (the rest of the round trip is network)
+    total_grant_wait_ += rclcpp::Duration(msg->grant_wait).nanoseconds() / 1e6;
+    n_grants_++;
+    update_blackboard(shard);
+    return;
+  }
+  if ((msg->type == bf_msgs::msg::Blackboard::ACK) && (msg->robot_id == robot_id_)) {
+    waiting_time_ = (rclcpp::Clock().now() - shard.t_last_request) + waiting_time_;
+    n_success_++;
+    BF_TRACE(get_logger(), "CAS %d committed (%zu keys)", n_success_, msg->entries.size());
+    for (const auto & entry : msg->entries) {
+      key_states_[entry.key].version = entry.version;
+    }
+    shard.cas_sent = false;
+    return;
+  }
+  if ((msg->type == bf_msgs::msg::Blackboard::CONFLICT) && (msg->robot_id == robot_id_)) {
+    // nothing was written. A key another robot wrote meanwhile takes the committed value
+    // (the stale local one is dropped, unless the tree wrote the key again since the CAS);
+    // the other keys were only leased and are written again through REQUEST/GRANT
+    BF_TRACE(get_logger(), "CAS conflict (%zu keys)", msg->entries.size());
+    std::unordered_set<std::string> superseded;
+    for (const auto & entry : msg->entries) {
+      auto & state = key_states_[entry.key];
+      if (entry.version > state.version &&
+        shard.pending_keys.find(entry.key) == shard.pending_keys.end())
+      {
+        if (TypeRegistry::instance().decode(entry, blackboard_)) {
+          remember(entry.key);
+        }
+        superseded.insert(entry.key);
+      }
+      state.version = std::max(state.version, entry.version);
+    }
+    for (const auto & key : shard.cas_keys) {
+      if (superseded.find(key) == superseded.end()) {
+        shard.pending_keys.insert(key);
+      }
+    }
+    shard.cas_sent = false;
+    shard.lock_fallback = true;
     return;
   }
   if ((msg->type == bf_msgs::msg::Blackboard::PUBLISH) && (msg->robot_id == robot_id_)) {
-    RCLCPP_DEBUG(get_logger(), "published global blackboard is mine");
+    BF_TRACE(get_logger(), "published global blackboard is mine");
     n_updates_++;
+    // values are already in the local blackboard, only the versions are new
+    for (const auto & entry : msg->entries) {
+      key_states_[entry.key].version = entry.version;
+    }
+    return;
   }
   if ((msg->type == bf_msgs::msg::Blackboard::PUBLISH) && (msg->robot_id != robot_id_)) {
     sync_rcvd_ = true;
-    RCLCPP_DEBUG(get_logger(), "UPDATING local blackboard");
+    shard.synced = shard.synced || msg->full_snapshot;
+    if (msg->full_snapshot) {
+      forget_versions(shard);  // the snapshot is the current state, whatever was seen before
+    }
+    BF_TRACE(
+      get_logger(), "UPDATING local blackboard (%zu keys%s)", msg->entries.size(),
+      msg->full_snapshot ? ", full" : "");
     n_updates_++;
-    for (int i = 0; i < msg->keys.size(); i++) {
-      RCLCPP_DEBUG(get_logger(), "%s = %s", msg->keys.at(i).c_str(), msg->values.at(i).c_str());
-      if (msg->key_types[i] == "string") {
-        blackboard_->set(msg->keys.at(i), msg->values.at(i));
-      } else if (msg->key_types[i] == "int") {
-        blackboard_->set(msg->keys.at(i), std::stoi(msg->values.at(i)));
-      } else if (msg->key_types[i] == "float") {
-        blackboard_->set(msg->keys.at(i), std::stof(msg->values.at(i)));
-      } else if (msg->key_types[i] == "double") {
-        blackboard_->set(msg->keys.at(i), std::stod(msg->values.at(i)));
-      } else if (msg->key_types[i] == "bool") {
-        blackboard_->set(msg->keys.at(i), static_cast<bool>(std::stoi(msg->values.at(i))));
-      } else {
-        RCLCPP_ERROR(get_logger(), "unknown type [%s]", msg->key_types[i].c_str());
+    for (const auto & entry : msg->entries) {
+      // skip entries that are not newer than what is already applied
+      auto state = key_states_.find(entry.key);
+      if (state != key_states_.end() && state->second.version >= entry.version) {
+        continue;
       }
+      // a local write not sent yet is newer; a batched delta may carry our previous value
+      if (shard.pending_keys.find(entry.key) != shard.pending_keys.end()) {
+        continue;
+      }
+      if (!TypeRegistry::instance().decode(entry, blackboard_)) {
+        RCLCPP_ERROR(get_logger(), "key %s: unknown type [%d]", entry.key.c_str(), entry.type);
+        continue;
+      }
+      remember(entry.key);  // a remote value, not a local change to send
+      key_states_[entry.key].version = entry.version;
     }
-    cache_blackboard();
     return;
   }
-  if ((msg->type == bf_msgs::msg::Blackboard::DENY) && (msg->robot_id != robot_id_)) {
-    RCLCPP_INFO(get_logger(), "access to blackboard DENIED");
-    request_sent_ = false;
+  if (msg->type == bf_msgs::msg::Blackboard::FAILOVER) {
+    // a standby manager took over with a new epoch: the versions of the shard were
+    // forgotten, the writes in flight queued again and SYNC (with the interest) sent again
+    // when it was seen, here or in its heartbeat
+    RCLCPP_WARN(
+      get_logger(), "%s took over the blackboard (epoch %u)", msg->robot_id.c_str(),
+      msg->epoch);
+    return;
+  }
+  if ((msg->type == bf_msgs::msg::Blackboard::DENY) && (msg->robot_id == robot_id_)) {
+    // the lease expired or was revoked: whatever it covered has to be written again
+    RCLCPP_INFO_THROTTLE(
+      get_logger(), *get_clock(), 1000, "access to blackboard DENIED (token %lu)", msg->token);
+    shard.pending_keys.insert(msg->keys.begin(), msg->keys.end());
+    shard.request_sent = false;
+    shard.access_granted = false;
     return;
   }
 }
 
-void BlackboardHandler::cache_blackboard()
+void BlackboardHandler::new_epoch(Shard & shard, uint32_t epoch)
 {
-  bb_cache_->clear();
-
-  std::vector<BT::StringView> string_views = blackboard_->getKeys();
-  for (const auto & string_view : string_views) {
-    try {
-      // check if the entry should be skipped
-      if (string_view.find("efbb_") != std::string::npos) {
-        excluded_keys_.push_back(string_view.data());
-        RCLCPP_DEBUG(get_logger(), "key %s excluded", string_view.data());
-        continue;
-      }
-      std::string type = get_type(string_view.data());
-
-      if (type == "string" || type == "unknown") {
-        bb_cache_->set(string_view.data(), blackboard_->get<std::string>(string_view.data()));
-      } else if (type == "int") {
-        bb_cache_->set(string_view.data(), blackboard_->get<int>(string_view.data()));
-      } else if (type == "float") {
-        bb_cache_->set(string_view.data(), blackboard_->get<float>(string_view.data()));
-      } else if (type == "double") {
-        bb_cache_->set(string_view.data(), blackboard_->get<double>(string_view.data()));
-      } else if (type == "bool") {
-        bb_cache_->set(string_view.data(), blackboard_->get<bool>(string_view.data()));
-      } else {
-        RCLCPP_ERROR(get_logger(), "unknown type [%s]", type.c_str());
-      }
+  bool first = shard.epoch == 0;
+  shard.epoch = epoch;
+  if (first) {
+    return;
+  }
+
+  // the manager restarted or a standby took over: the versions the handler knew may be
+  // above the new manager's, and whatever was in flight with the old one is lost
+  RCLCPP_WARN(get_logger(), "new blackboard manager epoch %u: synchronizing again", epoch);
+  forget_versions(shard);
+  if (shard.cas_sent) {
+    shard.pending_keys.insert(shard.cas_keys.begin(), shard.cas_keys.end());
+  }
+  shard.cas_sent = false;
+  shard.request_sent = false;
+  shard.access_granted = false;
+  shard.synced = false;
+  sync_bb(shard);
+}
+
+void BlackboardHandler::forget_versions(const Shard & shard)
+{
+  int index = &shard - shards_.data();
+  for (auto & state : key_states_) {
+    if (shard_map_.shard(state.first) == index) {
+      state.second.version = 0;
+    }
+  }
+}
 
-      RCLCPP_DEBUG(get_logger(), "key %s cached", string_view.data());
-    } catch (const std::exception & e) {
-      excluded_keys_.push_back(string_view.data());
-      RCLCPP_DEBUG(get_logger(), "key %s skipped", string_view.data());
+void BlackboardHandler::cache_blackboard()
+{
+  // the values present at startup are taken as already shared
+  for (const auto & string_view : blackboard_->getKeys()) {
+    std::string key(string_view);
+    if (!excluded(key)) {
+      remember(key);
     }
   }
 }
 
-void BlackboardHandler::update_blackboard()
+bool BlackboardHandler::remember(const std::string & key)
+{
+  // entries declared but not written yet are remembered once they hold a value
+  bf_msgs::msg::BlackboardEntry entry;
+  if (!TypeRegistry::instance().encode(blackboard_, key, &entry)) {
+    return false;
+  }
+  uint64_t value = fingerprint(entry);
+  auto & state = key_states_[key];
+  bool changed = state.type != entry.type || state.fingerprint != value;
+  state.fingerprint = value;
+  state.type = entry.type;
+  return changed;
+}
+
+void BlackboardHandler::update_blackboard(Shard & shard)
 {
   bf_msgs::msg::Blackboard msg;
 
-  if (access_granted_) {
-    waiting_time_ = (rclcpp::Clock().now() - t_last_request_) + waiting_time_;
+  if (shard.access_granted) {
+    waiting_time_ = (rclcpp::Clock().now() - shard.t_last_request) + waiting_time_;
     n_success_++;
     avg_waiting_time_ = (waiting_time_.nanoseconds() / n_success_) / 1e6;  // millis
-    RCLCPP_DEBUG(
+    BF_TRACE(
       get_logger(), "BB update SUCCESS %d: updating shared blackboard (%f ms)", n_success_,
       avg_waiting_time_);
-    std::vector<BT::StringView> string_views = blackboard_->getKeys();
+    // only the keys changed since the last write are sent, if the grant covers them
+    // (an empty grant covers every key of the shard)
+    std::vector<std::string> keys;
+    if (shard.granted_keys.empty()) {
+      keys.assign(shard.pending_keys.begin(), shard.pending_keys.end());
+    } else {
+      for (const auto & key : shard.granted_keys) {
+        if (shard.pending_keys.find(key) != shard.pending_keys.end()) {
+          keys.push_back(key);
+        }
+      }
+    }
+
     msg.robot_id = robot_id_;
     msg.type = bf_msgs::msg::Blackboard::UPDATE;
-    std::vector<std::string> keys;
-    std::vector<std::string> values;
-    std::vector<std::string> types;
-    msg.values = {};
-    for (const auto & string_view : string_views) {
-      if (std::find(
-          excluded_keys_.begin(), excluded_keys_.end(),
-          string_view.data()) == excluded_keys_.end())
-      {
-        keys.push_back(string_view.data());
-        values.push_back(blackboard_->get<std::string>(string_view.data()));
-        types.push_back(get_type(string_view.data()));
+    msg.token = shard.grant_token;
+    msg.entries.reserve(keys.size());
+    for (const auto & key : keys) {
+      shard.pending_keys.erase(key);
+      if (!excluded(key)) {
+        bf_msgs::msg::BlackboardEntry entry;
+        if (TypeRegistry::instance().encode(blackboard_, key, &entry)) {
+          msg.entries.push_back(std::move(entry));
+        }
       }
     }
-    msg.keys = keys;
-    msg.values = values;
-    msg.key_types = types;
-    bb_pub_->publish(msg);
-    request_sent_ = false;
-    access_granted_ = false;
+    send(shard, msg);
+    shard.request_sent = false;
+    shard.access_granted = false;
+    shard.lock_fallback = false;
+    shard.dirty = false;  // keys written meanwhile start a new interval
   } else {
-    RCLCPP_DEBUG(get_logger(), "requesting access to blackboard");
+    BF_TRACE(get_logger(), "requesting access to blackboard");
     msg.type = bf_msgs::msg::Blackboard::REQUEST;
     msg.robot_id = robot_id_;
-    if (!request_sent_) {
-      bb_pub_->publish(msg);
-      request_sent_ = true;
+    msg.keys.assign(shard.pending_keys.begin(), shard.pending_keys.end());
+    msg.priority = priority_;
+    msg.deadline_ms = deadline_ms_;
+    if (!shard.request_sent) {
+      send(shard, msg);
+      shard.request_sent = true;
       n_requests_++;
-      t_last_request_ = rclcpp::Clock().now();
+      shard.t_last_request = rclcpp::Clock().now();
     } else {
-      RCLCPP_DEBUG(get_logger(), "waiting for access to blackboard");
-      if ((rclcpp::Clock().now() - t_last_request_).seconds() > 5.0) {
-        RCLCPP_DEBUG(get_logger(), "request timed out");
-        request_sent_ = false;
+      BF_TRACE(get_logger(), "waiting for access to blackboard");
+      if ((rclcpp::Clock().now() - shard.t_last_request).seconds() > 5.0) {
+        BF_TRACE(get_logger(), "request timed out");
+        shard.request_sent = false;
       }
     }
   }
 }
 
-bool BlackboardHandler::updating_bb()
-{
-  return access_granted_;
-}
-
-void BlackboardHandler::sync_bb()
+void BlackboardHandler::compare_and_swap(Shard & shard)
 {
-  RCLCPP_DEBUG(get_logger(), "synchronizing with global blackboard");
+  if (shard.cas_sent) {
+    if ((rclcpp::Clock().now() - shard.t_last_request).seconds() > 5.0) {
+      BF_TRACE(get_logger(), "CAS timed out");
+      shard.pending_keys.insert(shard.cas_keys.begin(), shard.cas_keys.end());
+      shard.cas_sent = false;
+    }
+    return;
+  }
 
   bf_msgs::msg::Blackboard msg;
-  msg.type = bf_msgs::msg::Blackboard::SYNC;
+  msg.type = bf_msgs::msg::Blackboard::CAS;
   msg.robot_id = robot_id_;
-  bb_pub_->publish(msg);
+  msg.entries.reserve(shard.pending_keys.size());
+  shard.cas_keys.clear();
+
+  for (const auto & key : shard.pending_keys) {
+    if (excluded(key)) {
+      continue;
+    }
+    bf_msgs::msg::BlackboardEntry entry;
+    if (TypeRegistry::instance().encode(blackboard_, key, &entry)) {
+      auto state = key_states_.find(key);
+      entry.version = (state != key_states_.end()) ? state->second.version : 0;
+      msg.entries.push_back(std::move(entry));
+      shard.cas_keys.push_back(key);
+    }
+  }
+  shard.pending_keys.clear();
+
+  if (msg.entries.empty()) {
+    return;
+  }
+
+  BF_TRACE(get_logger(), "sending CAS (%zu keys)", msg.entries.size());
+  send(shard, msg);
+  shard.cas_sent = true;
+  shard.dirty = false;
+  n_requests_++;
+  shard.t_last_request = rclcpp::Clock().now();
 }
 
-std::string BlackboardHandler::get_type(const char * port_name)
+bool BlackboardHandler::updating_bb()
 {
-  const BT::PortInfo * port = blackboard_->portInfo(port_name);
-  // thirdparty library updated, so this is not working anymore. Not tested
-  // const BT::TypeInfo * port = bb->entryInfo(port_name);
-  int status;
-  char * port_type = abi::__cxa_demangle(port->type().name(), nullptr, nullptr, &status);
-  std::string type(port_type);
-  std::free(port_type);
-
-  if (type.find("Any") != std::string::npos) {
-    return "string";
+  for (const auto & shard : shards_) {
+    if (shard.access_granted) {
+      return true;
+    }
   }
-  if (type.find("string") != std::string::npos) {
-    return "string";
+  return false;
+}
+
+void BlackboardHandler::reset()
+{
+  // a held lease is released with the writes it covers, before they are dropped; otherwise
+  // the manager would keep the keys locked until the lease expires
+  for (auto & shard : shards_) {
+    if (shard.access_granted) {
+      update_blackboard(shard);
+    }
   }
-  if (type.find("int") != std::string::npos) {
-    return "int";
+
+  {
+    std::lock_guard<std::mutex> lock(writes_mutex_);
+    written_keys_.clear();
   }
-  if (type.find("float") != std::string::npos) {
-    return "float";
+  scan_requested_ = false;
+  key_states_.clear();
+  excluded_keys_.clear();
+  blackboard_->clear();
+  cache_blackboard();
+
+  // the topics stay, the pending, lease and CAS state of every shard is cleared
+  for (auto & shard : shards_) {
+    Shard fresh;
+    fresh.pub = shard.pub;
+    fresh.reply_sub = shard.reply_sub;
+    fresh.data_sub = shard.data_sub;
+    fresh.heartbeat_sub = shard.heartbeat_sub;
+    fresh.epoch = shard.epoch;
+    shard = std::move(fresh);
   }
-  if (type.find("double") != std::string::npos) {
-    return "double";
+  sync_rcvd_ = false;
+  for (auto & shard : shards_) {
+    sync_bb(shard);
   }
-  if (type.find("bool") != std::string::npos) {
-    return "bool";
+}
+
+void BlackboardHandler::heartbeat_callback(
+  bf_msgs::msg::Blackboard::UniquePtr msg,
+  Shard & shard)
+{
+  // a standby that took over, or a primary that restarted, has a later epoch. Only the
+  // primary's heartbeat counts, and only forwards, so that a deposed primary still beating
+  // until it steps down does not make the handler synchronize back and forth
+  if (msg->type != bf_msgs::msg::Blackboard::HEARTBEAT || msg->keys.empty() ||
+    msg->keys[0] != "primary" || msg->epoch <= shard.epoch)
+  {
+    return;
   }
+  new_epoch(shard, msg->epoch);
+}
 
-  return "unknown";
+void BlackboardHandler::sync_bb(Shard & shard)
+{
+  BF_TRACE(get_logger(), "synchronizing with global blackboard");
+
+  bf_msgs::msg::Blackboard msg;
+  msg.type = bf_msgs::msg::Blackboard::SYNC;
+  msg.robot_id = robot_id_;
+  msg.keys = interest_.rules();  // registered with the manager (empty = every key)
+  send(shard, msg);
+  shard.t_last_sync = rclcpp::Clock().now();
 }
 
-void BlackboardHandler::reset()
+void BlackboardHandler::send(Shard & shard, bf_msgs::msg::Blackboard & msg)
 {
-  blackboard_->clear();
-  cache_blackboard();
+  // large entries are compressed only if the manager said it can read them
+  codec_.advertise(msg);
+  if (shard.manager_reads_zstd) {
+    codec_.compress(msg);
+  }
+  shard.pub->publish(msg);
 }
 
 }  // namespace BF
@@ -30,8 +30,9 @@ BlackboardManager::BlackboardManager(
   using ::std::chrono_literals::operator""ms;
   msq_size_ = 10;
   init();
-  RCLCPP_INFO(get_logger(), "control cycle: 50 ms");
-  timer_cycle_ = create_wall_timer(50ms, std::bind(&BlackboardManager::control_cycle, this));
+  RCLCPP_INFO(get_logger(), "watchdog cycle: 50 ms");
+  timer_cycle_ = create_wall_timer(
+    50ms, with_state(&BlackboardManager::control_cycle), state_group_);
   copy_blackboard(blackboard);
 }
 
@@ -45,8 +46,9 @@ BlackboardManager::BlackboardManager(
   init();
   copy_blackboard(blackboard);
 
-  RCLCPP_INFO(get_logger(), "control cycle: %ld ms", milis.count());
-  timer_cycle_ = create_wall_timer(milis, std::bind(&BlackboardManager::control_cycle, this));
+  RCLCPP_INFO(get_logger(), "watchdog cycle: %ld ms", milis.count());
+  timer_cycle_ = create_wall_timer(
+    milis, with_state(&BlackboardManager::control_cycle), state_group_);
 }
 
 BlackboardManager::BlackboardManager(
@@ -59,66 +61,483 @@ BlackboardManager::BlackboardManager(
   init();
   copy_blackboard(blackboard);
 
-  RCLCPP_INFO(get_logger(), "control cycle: %ld ms", milis.count());
-  timer_cycle_ = create_wall_timer(milis, std::bind(&BlackboardManager::control_cycle, this));
+  RCLCPP_INFO(get_logger(), "watchdog cycle: %ld ms", milis.count());
+  timer_cycle_ = create_wall_timer(
+    milis, with_state(&BlackboardManager::control_cycle), state_group_);
   RCLCPP_INFO(get_logger(), "blackboard refresh rate: %ld ms", bb_refresh_rate.count());
-  timer_publish_ =
-    create_wall_timer(bb_refresh_rate, std::bind(&BlackboardManager::publish_blackboard, this));
+  timer_publish_ = create_wall_timer(
+    bb_refresh_rate, with_state(&BlackboardManager::publish_blackboard), state_group_);
 }
+
+BlackboardManager::~BlackboardManager()
+{
+  running_ = false;
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+  }
+  commit_cv_.notify_all();
+  publish_cv_.notify_all();
+  if (commit_thread_.joinable()) {
+    commit_thread_.join();
+  }
+  if (publish_thread_.joinable()) {
+    publish_thread_.join();
+  }
+}
+
 void BlackboardManager::init()
 {
-  lock_ = false;
-  sync_ = false;
   robot_id_ = "";
+  n_whole_leases_ = 0;
+  token_ = 0;
   tam_q_ = 0;
   n_pub_ = 0;
+  version_ = 0;
+  epoch_ = 0;
+  n_commits_ = 0;
+  n_wal_records_ = 0;
+  n_compressed_ = 0;
+  raw_bytes_ = 0;
+  compressed_bytes_ = 0;
 
   blackboard_ = BT::Blackboard::create();
 
-  bb_pub_ = create_publisher<bf_msgs::msg::Blackboard>(
-    "/blackboard", 100);
+  // requests are taken (and decompressed) one at a time, so they are queued in arrival
+  // order, on an executor thread of their own; timers and the manager links share another
+  // mutually exclusive group and the state lock with the commit thread
+  ingest_group_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  state_group_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  rclcpp::SubscriptionOptions ingest_options, state_options;
+  ingest_options.callback_group = ingest_group_;
+  state_options.callback_group = state_group_;
+
+  lease_timeout_ = declare_parameter("lease_timeout_ms", 5000) / 1000.0;
+  preempt_timeout_ = declare_parameter("preempt_timeout_ms", 0) / 1000.0;
+  RCLCPP_INFO(
+    get_logger(), "lease timeout: %.3f s (preemption after %.3f s)", lease_timeout_,
+    preempt_timeout_);
+
+  scheduler_ = GrantScheduler(
+    declare_parameter("robot_weights", std::vector<std::string>{}));
+  RCLCPP_INFO(get_logger(), "grant scheduler: %zu robot weights", scheduler_.n_weights());
+
+  commit_window_ = std::chrono::milliseconds(declare_parameter("commit_window_ms", 0));
+  commit_batch_size_ = declare_parameter("commit_batch_size", 0);
+  RCLCPP_INFO(
+    get_logger(), "commit window: %ld ms (batch size %d)", commit_window_.count(),
+    commit_batch_size_);
+
+  shard_map_ = ShardMap(
+    declare_parameter("shards", 1),
+    declare_parameter("shard_prefixes", std::vector<std::string>{}));
+  shard_id_ = declare_parameter("shard_id", 0);
+  if (shard_id_ < 0 || shard_id_ >= shard_map_.shards()) {
+    RCLCPP_ERROR(get_logger(), "invalid shard_id %d, using shard 0", shard_id_);
+    shard_id_ = 0;
+  }
+  RCLCPP_INFO(
+    get_logger(), "shard %d/%d on %s (%zu prefix rules)", shard_id_, shard_map_.shards(),
+    shard_map_.topic(shard_id_).c_str(), shard_map_.n_rules());
+
+  exclude_keys_ = KeyFilter(
+    declare_parameter("exclude_keys", std::vector<std::string>{"*efbb_*"}));
+  include_keys_ = KeyFilter(declare_parameter("include_keys", std::vector<std::string>{}));
+
+  // persistence: recover the blackboard of a previous run before anything is copied
+  std::string persistence_dir = declare_parameter("persistence_dir", std::string(""));
+  bool persistence_sync = declare_parameter("persistence_sync", true);
+  auto checkpoint_interval =
+    std::chrono::milliseconds(declare_parameter("checkpoint_interval_ms", 10000));
+  if (!persistence_dir.empty()) {
+    if (shard_map_.shards() > 1) {
+      persistence_dir += "/shard_" + std::to_string(shard_id_);
+    }
+    recover_blackboard(persistence_dir, persistence_sync);
+    if (store_.is_open() && checkpoint_interval.count() > 0) {
+      timer_checkpoint_ = create_wall_timer(
+        checkpoint_interval, with_state(&BlackboardManager::checkpoint_blackboard),
+        state_group_);
+    }
+  }
+
+  // compression of large publications
+  codec_ = PayloadCodec(
+    declare_parameter("compression_threshold", 0),
+    declare_parameter("compression_dictionary", std::string("")),
+    declare_parameter("compression_level", 3));
+  if (codec_.dictionary_failed()) {
+    RCLCPP_ERROR(get_logger(), "cannot load the compression dictionary: compression disabled");
+  }
+  RCLCPP_INFO(
+    get_logger(), "compression: %s (dictionary %u)", codec_.enabled() ? "zstd" : "off",
+    codec_.dictionary_id());
+
+  data_pub_ = create_publisher<bf_msgs::msg::Blackboard>(
+    shard_map_.data_topic(shard_id_), 100);
+
+  requests_sub_ = create_subscription<bf_msgs::msg::Blackboard>(
+    shard_map_.requests_topic(shard_id_), rclcpp::SensorDataQoS().keep_last(msq_size_),
+    std::bind(&BlackboardManager::enqueue, this, std::placeholders::_1), ingest_options);
 
-  bb_sub_ = create_subscription<bf_msgs::msg::Blackboard>(
-    "/blackboard", rclcpp::SensorDataQoS().keep_last(msq_size_),
-    std::bind(&BlackboardManager::blackboard_callback, this, std::placeholders::_1));
+  // replication: the primary ships its log and heartbeats; a standby follows them
+  failover_timeout_ = declare_parameter("failover_timeout_ms", 1000) / 1000.0;
+  auto heartbeat_period = std::chrono::milliseconds(declare_parameter("heartbeat_ms", 200));
+  t_primary_hb_ = rclcpp::Clock().now();
+
+  heartbeat_pub_ = create_publisher<bf_msgs::msg::Blackboard>(
+    shard_map_.heartbeat_topic(shard_id_), 10);
+  heartbeat_sub_ = create_subscription<bf_msgs::msg::Blackboard>(
+    shard_map_.heartbeat_topic(shard_id_), 10,
+    std::bind(&BlackboardManager::heartbeat_callback, this, std::placeholders::_1),
+    state_options);
+  // records shipped before the standby's subscription is matched are kept for it
+  log_pub_ = create_publisher<bf_msgs::msg::Blackboard>(
+    shard_map_.log_topic(shard_id_), rclcpp::QoS(1000).reliable().transient_local());
+
+  set_role(declare_parameter("role", std::string("primary")) == "standby");
+  if (!standby_) {
+    new_epoch();
+  }
+  RCLCPP_INFO(
+    get_logger(), "role: %s (heartbeat %ld ms, failover after %.3f s)",
+    standby_ ? "standby" : "primary", heartbeat_period.count(), failover_timeout_);
+  timer_heartbeat_ = create_wall_timer(
+    heartbeat_period, with_state(&BlackboardManager::heartbeat), state_group_);
+
+  // live statistics
+  auto stats_period = std::chrono::milliseconds(declare_parameter("stats_period_ms", 1000));
+  stats_pub_ = create_publisher<bf_msgs::msg::BlackboardStats>(
+    shard_map_.stats_topic(shard_id_), 10);
+  t_last_stats_ = rclcpp::Clock().now();
+  if (stats_period.count() > 0) {
+    timer_stats_ = create_wall_timer(
+      stats_period, with_state(&BlackboardManager::publish_stats), state_group_);
+  }
+
+  // per-message logs are compiled out (see Trace.hpp): a summary is logged instead
+  auto summary_period =
+    std::chrono::milliseconds(declare_parameter("summary_period_ms", 5000));
+  if (summary_period.count() > 0) {
+    timer_summary_ = create_wall_timer(
+      summary_period, with_state(&BlackboardManager::log_summary), state_group_);
+  }
+
+  // commit and publish threads
+  running_ = true;
+  commit_thread_ = std::thread(&BlackboardManager::commit_loop, this);
+  publish_thread_ = std::thread(&BlackboardManager::publish_loop, this);
 
   // uncomment for testing
   // rclcpp::on_shutdown([this]() {dump_blackboard();});
 }
 
+std::function<void()> BlackboardManager::with_state(void (BlackboardManager::* callback)())
+{
+  return [this, callback]() {
+           std::lock_guard<std::mutex> lock(state_mutex_);
+           (this->*callback)();
+         };
+}
+
+void BlackboardManager::enqueue(bf_msgs::msg::Blackboard::UniquePtr msg)
+{
+  // the robot_id names the reply topic of the robot: anything else could not be answered
+  if (!ShardMap::valid_robot_id(msg->robot_id)) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000, "message dropped: invalid robot_id \"%.64s\"",
+      msg->robot_id.c_str());
+    return;
+  }
+  // payloads are decompressed here, on the ingest thread
+  if (!codec_.decompress(*msg)) {
+    RCLCPP_ERROR(
+      get_logger(), "message of %s dropped: its payload cannot be decompressed",
+      msg->robot_id.c_str());
+    return;
+  }
+  requests_.push(std::move(msg));
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+  }
+  commit_cv_.notify_one();
+}
+
+void BlackboardManager::commit_loop()
+{
+  bf_msgs::msg::Blackboard::UniquePtr msg;
+  while (running_) {
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      commit_cv_.wait(lock, [this]() {return !running_ || !requests_.empty();});
+    }
+
+    // the queued messages are applied in arrival order, in batches, so that the timers and
+    // the manager links waiting on state_mutex_ get in between batches of a long backlog
+    bool more = true;
+    while (running_ && more) {
+      std::lock_guard<std::mutex> lock(state_mutex_);
+      for (size_t n = 0; n < COMMIT_BATCH && (more = requests_.pop(msg)); n++) {
+        blackboard_callback(std::move(msg));
+      }
+    }
+  }
+}
+
+void BlackboardManager::publish_loop()
+{
+  Publication publication;
+  while (running_) {
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      publish_cv_.wait(lock, [this]() {return !running_ || !publications_.empty();});
+    }
+
+    while (running_ && publications_.pop(publication)) {
+      auto t_compress = std::chrono::steady_clock::now();
+      size_t raw_size = publication.compress ? codec_.compress(*publication.msg) : 0;
+      size_t compressed_size = publication.msg->payload.size();
+      auto t_publish = std::chrono::steady_clock::now();
+      publication.pub->publish(std::move(publication.msg));
+      auto t_end = std::chrono::steady_clock::now();
+
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      publish_time_.record(std::chrono::duration<double>(t_end - t_publish).count());
+      if (raw_size > 0) {
+        compress_time_.record(std::chrono::duration<double>(t_publish - t_compress).count());
+        n_compressed_++;
+        raw_bytes_ += raw_size;
+        compressed_bytes_ += compressed_size;
+      }
+    }
+  }
+}
+
+void BlackboardManager::publish(
+  bf_msgs::msg::Blackboard::UniquePtr msg,
+  const rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr & pub,
+  bool compress)
+{
+  codec_.advertise(*msg);
+  msg->epoch = epoch_;
+  Publication publication;
+  publication.pub = pub;
+  publication.msg = std::move(msg);
+  publication.compress = compress;
+  publications_.push(std::move(publication));
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+  }
+  publish_cv_.notify_one();
+}
+
+bool BlackboardManager::reads_payloads(const std::string & robot_id) const
+{
+  auto robot = zstd_readers_.find(robot_id);
+  return robot != zstd_readers_.end() && robot->second;
+}
+
+bool BlackboardManager::compress_data() const
+{
+  // only if every subscriber of the data topic is a robot that negotiated compression: a
+  // plain robot, or a subscriber that never sent SYNC (e.g. `ros2 topic echo`), is left
+  // with more subscriptions than readers
+  size_t readers = 0;
+  for (const auto & robot : zstd_readers_) {
+    if (robot.first == standby_name_ || interests_.find(robot.first) != interests_.end()) {
+      continue;  // not on the data topic
+    }
+    if (!robot.second) {
+      return false;
+    }
+    readers++;
+  }
+  return readers > 0 && readers >= data_pub_->get_subscription_count();
+}
+
 void BlackboardManager::control_cycle()
 {
-  if (!lock_ && !q_.empty()) {
-    if (q_.size() > tam_q_) {
-      tam_q_ = q_.size();
-      RCLCPP_INFO(get_logger(), "max.queue size: %zu", q_.size());
+  if (standby_) {
+    return;
+  }
+  // grants are dispatched as soon as a request arrives or a lease is released;
+  // the timer only reclaims expired leases and retries whatever is still queued
+  expire_leases();
+  dispatch_grants();
+}
+
+void BlackboardManager::dispatch_grants()
+{
+  if (scheduler_.size() > tam_q_) {
+    tam_q_ = scheduler_.size();
+    BF_TRACE(get_logger(), "max.queue size: %zu", scheduler_.size());
+  }
+
+  // nothing can be granted while a robot holds the whole blackboard
+  if (n_whole_leases_ > 0) {
+    return;
+  }
+
+  // grant every request whose keys are free, in scheduler order. Requests that conflict
+  // keep that order: keys wanted by a request still waiting are not granted to later ones
+  std::unordered_set<std::string> reserved;
+  bool reserved_all = false;
+
+  const auto & queue = scheduler_.ordered();
+  for (auto it = queue.begin(); it != queue.end() && !reserved_all; ) {
+    const auto & request = *it++;  // granted requests leave the queue
+    bool whole = request.keys.empty();
+    bool blocked = reserved_all || (whole && !reserved.empty()) ||
+      (leases_.find(request.robot_id) != leases_.end()) || !is_free(request);
+    for (const auto & key : request.keys) {
+      if (blocked) {
+        break;
+      }
+      blocked = reserved.find(key) != reserved.end();
     }
 
-    robot_id_ = q_.front();
-    waiting_times_.push_back(rclcpp::Clock().now() - q_start_wait_.front());
-    RCLCPP_INFO(
-      get_logger(), "dequeuing robot %s (%zu pending). Waiting for %fs", q_.front().c_str(),
-      q_.size() - 1,
-      (rclcpp::Clock().now() - q_start_wait_.front()).nanoseconds() / 1e9);
-    q_.pop();
-    q_start_wait_.pop();
-    grant_blackboard();
-  } else if ((rclcpp::Clock().now() - t_last_grant_).seconds() > 5.0) {
-    // RCLCPP_INFO(get_logger(), "blackboard free");
-    robot_id_ = "";
-    lock_ = false;
+    if (blocked) {
+      if (whole) {
+        reserved_all = true;
+      } else {
+        reserved.insert(request.keys.begin(), request.keys.end());
+      }
+      continue;
+    }
+
+    grant_blackboard(request);
+    scheduler_.pop(request.robot_id);
   }
 }
 
-void BlackboardManager::grant_blackboard()
+bool BlackboardManager::is_free(const WriteRequest & request)
 {
-  t_last_grant_ = rclcpp::Clock().now();
-  RCLCPP_INFO(get_logger(), "granting blackboard to [%s]", robot_id_.c_str());
+  if (request.keys.empty()) {
+    return leases_.empty();
+  }
+  if (n_whole_leases_ > 0) {
+    return false;
+  }
+  for (const auto & key : request.keys) {
+    if (key_owners_.find(key) != key_owners_.end()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BlackboardManager::grant_blackboard(const WriteRequest & request)
+{
+  rclcpp::Duration wait = rclcpp::Clock().now() - request.t_start;
+  grant_wait_.record(wait.seconds());
+  grant_wait_total_.record(wait.seconds());
+  counters_.grants++;
+  BF_TRACE(
+    get_logger(), "granting blackboard to [%s] (%zu keys, %zu pending). Waiting for %fs",
+    request.robot_id.c_str(), request.keys.size(), scheduler_.size() - 1,
+    wait.nanoseconds() / 1e9);
+
+  Lease lease;
+  lease.keys = request.keys;
+  lease.t_grant = rclcpp::Clock().now();
+  lease.token = ++token_;
+  for (const auto & key : lease.keys) {
+    key_owners_[key] = request.robot_id;
+  }
+  if (lease.keys.empty()) {
+    n_whole_leases_++;
+  }
+  leases_[request.robot_id] = lease;
+
   bf_msgs::msg::Blackboard answ;
   answ.type = bf_msgs::msg::Blackboard::GRANT;
-  answ.robot_id = robot_id_;
-  bb_pub_->publish(answ);
-  lock_ = true;
+  answ.robot_id = request.robot_id;
+  answ.keys = request.keys;
+  answ.grant_wait = wait;
+  answ.token = lease.token;
+  reply(answ);
+}
+
+void BlackboardManager::release_lease(const std::string & robot_id, bool revoked)
+{
+  auto lease = leases_.find(robot_id);
+  if (lease == leases_.end()) {
+    return;
+  }
+
+  double held = (rclcpp::Clock().now() - lease->second.t_grant).seconds();
+  HoldStats & stats = hold_stats_[robot_id];
+  stats.n_leases++;
+  stats.total += held;
+  stats.max = std::max(stats.max, held);
+  hold_time_.record(held);
+  if (revoked) {
+    stats.n_revoked++;
+  }
+
+  for (const auto & key : lease->second.keys) {
+    auto owner = key_owners_.find(key);
+    if (owner != key_owners_.end() && owner->second == robot_id) {
+      key_owners_.erase(owner);
+    }
+  }
+  if (lease->second.keys.empty()) {
+    n_whole_leases_--;
+  }
+  leases_.erase(lease);
+}
+
+void BlackboardManager::expire_leases()
+{
+  rclcpp::Time now = rclcpp::Clock().now();
+
+  // keys other robots are waiting for
+  std::unordered_set<std::string> wanted;
+  bool wanted_all = false;
+  if (preempt_timeout_ > 0.0) {
+    for (const auto & request : scheduler_.ordered()) {
+      wanted_all = wanted_all || request.keys.empty();
+      wanted.insert(request.keys.begin(), request.keys.end());
+    }
+  }
+
+  std::vector<std::string> revoked;
+  for (const auto & lease : leases_) {
+    double held = (now - lease.second.t_grant).seconds();
+    bool is_wanted = wanted_all || (lease.second.keys.empty() && !scheduler_.empty());
+    for (const auto & key : lease.second.keys) {
+      if (is_wanted) {
+        break;
+      }
+      is_wanted = wanted.find(key) != wanted.end();
+    }
+
+    if ((held > lease_timeout_) ||
+      (preempt_timeout_ > 0.0 && held > preempt_timeout_ && is_wanted))
+    {
+      revoked.push_back(lease.first);
+    }
+  }
+
+  for (const auto & robot_id : revoked) {
+    const Lease & lease = leases_[robot_id];
+    RCLCPP_INFO(
+      get_logger(), "lease %lu of robot %s revoked after %fs", lease.token, robot_id.c_str(),
+      (now - lease.t_grant).seconds());
+    deny(robot_id, lease.token, lease.keys);
+    release_lease(robot_id, true);
+  }
+}
+
+void BlackboardManager::deny(
+  const std::string & robot_id, uint64_t token,
+  const std::vector<std::string> & keys)
+{
+  bf_msgs::msg::Blackboard answ;
+  answ.type = bf_msgs::msg::Blackboard::DENY;
+  answ.robot_id = robot_id;
+  answ.token = token;
+  answ.keys = keys;
+  reply(answ);
 }
 
 void BlackboardManager::blackboard_callback(bf_msgs::msg::Blackboard::UniquePtr msg)
@@ -126,148 +545,749 @@ void BlackboardManager::blackboard_callback(bf_msgs::msg::Blackboard::UniquePtr
   update_bb_msg_ = std::move(msg);
   bf_msgs::msg::Blackboard answ;
 
+  // both managers keep the interest set of every robot (carried by its SYNC)
+  bool is_sync = update_bb_msg_->type == bf_msgs::msg::Blackboard::SYNC &&
+    update_bb_msg_->robot_id != get_name();
+  if (is_sync) {
+    register_interest(*update_bb_msg_);
+  }
+
+  if (standby_) {
+    // a standby only serves SYNC, once it holds a copy of the blackboard
+    if (is_sync && synced_) {
+      RCLCPP_INFO(
+        get_logger(), "sychronization request from %s served by the standby",
+        update_bb_msg_->robot_id.c_str());
+      serve_sync(update_bb_msg_->robot_id);
+    }
+    return;
+  }
+
+  // the reply topic is created on the first message of a robot (its SYNC), so it
+  // is usually matched by the time the first GRANT has to be sent
+  reply_pub(update_bb_msg_->robot_id);
+
   if (update_bb_msg_->type == bf_msgs::msg::Blackboard::REQUEST) {
-    // enqueue all requests
-    q_.push(update_bb_msg_->robot_id);
-    q_start_wait_.push(rclcpp::Clock().now());
-    RCLCPP_INFO(get_logger(), "request from robot %s enqueued", update_bb_msg_->robot_id.c_str());
-  } else if ((update_bb_msg_->type == bf_msgs::msg::Blackboard::UPDATE) &&
-    (update_bb_msg_->robot_id == robot_id_))
-  {
-    update_blackboard();  // attend request coming from the robot that has the blackboard
+    WriteRequest request;
+    request.robot_id = update_bb_msg_->robot_id;
+    request.keys = update_bb_msg_->keys;
+    request.t_start = rclcpp::Clock().now();
+    request.priority = update_bb_msg_->priority;
+    if (update_bb_msg_->deadline_ms > 0) {
+      request.deadline = request.t_start +
+        rclcpp::Duration(std::chrono::milliseconds(update_bb_msg_->deadline_ms));
+    }
+    counters_.requests++;
+    if (scheduler_.push(request)) {
+      BF_TRACE(
+        get_logger(), "request from robot %s enqueued (%zu keys, priority %d)",
+        request.robot_id.c_str(), request.keys.size(), request.priority);
+    } else {
+      BF_TRACE(
+        get_logger(), "request from robot %s merged with its queued one",
+        request.robot_id.c_str());
+    }
+    dispatch_grants();
+  } else if (update_bb_msg_->type == bf_msgs::msg::Blackboard::UPDATE) {
+    auto lease = leases_.find(update_bb_msg_->robot_id);
+    if (lease != leases_.end() && lease->second.token == update_bb_msg_->token) {
+      update_blackboard();  // attend request coming from a robot holding a lease
+    } else {
+      // the lease expired (or was never granted): fence the late writer off
+      counters_.rejected++;  // reported in the stats
+      BF_TRACE(
+        get_logger(), "UPDATE from %s rejected (token %lu)", update_bb_msg_->robot_id.c_str(),
+        update_bb_msg_->token);
+      std::vector<std::string> keys;
+      for (const auto & entry : update_bb_msg_->entries) {
+        keys.push_back(entry.key);
+      }
+      deny(update_bb_msg_->robot_id, update_bb_msg_->token, keys);
+    }
+  } else if (update_bb_msg_->type == bf_msgs::msg::Blackboard::CAS) {
+    compare_and_swap();
   } else if (update_bb_msg_->type == bf_msgs::msg::Blackboard::SYNC) {
+    bool standby_alive = (rclcpp::Clock().now() - t_standby_hb_).seconds() < failover_timeout_;
+    if (standby_alive && update_bb_msg_->robot_id != standby_name_) {
+      return;  // the standby answers it
+    }
     RCLCPP_INFO(
       get_logger(), "sychronization request received from %s", update_bb_msg_->robot_id.c_str());
-    sync_ = true;
-    publish_blackboard();
+    serve_sync(update_bb_msg_->robot_id);
   }
 }
 
 void BlackboardManager::update_blackboard()
 {
-  RCLCPP_INFO(get_logger(), "%s updating blackboard", robot_id_.c_str());
-
-  std::vector<std::string> keys = update_bb_msg_->keys;
-  std::vector<std::string> values = update_bb_msg_->values;
-  std::vector<std::string> types = update_bb_msg_->key_types;
-
-  for (int i = 0; i < keys.size(); i++) {
-    if (types[i] == "string" || types[i] == "unknown") {
-      blackboard_->set(keys[i], values[i]);
-    } else if (types[i] == "int") {
-      blackboard_->set(keys[i], std::stoi(values[i]));
-    } else if (types[i] == "float") {
-      blackboard_->set(keys[i], std::stof(values[i]));
-    } else if (types[i] == "double") {
-      blackboard_->set(keys[i], std::stod(values[i]));
-    } else if (types[i] == "bool") {
-      blackboard_->set(keys[i], static_cast<bool>(std::stoi(values[i])));
-    } else {
-      RCLCPP_ERROR(get_logger(), "unknown type in the blackboard [%s]", types[i].c_str());
+  const std::string & robot_id = update_bb_msg_->robot_id;
+  counters_.updates++;
+  BF_TRACE(get_logger(), "%s updating blackboard", robot_id.c_str());
+
+  // only the keys covered by the robot's lease are written
+  const auto & leased = leases_[robot_id].keys;
+  std::unordered_set<std::string> writable(leased.begin(), leased.end());
+  auto t_apply = std::chrono::steady_clock::now();
+
+  for (const auto & entry : update_bb_msg_->entries) {
+    if (!leased.empty() && writable.find(entry.key) == writable.end()) {
+      RCLCPP_ERROR(
+        get_logger(), "key %s is not leased to %s", entry.key.c_str(), robot_id.c_str());
+      continue;
     }
+
+    // only the keys whose value actually changed get a new version
+    if (versions_.find(entry.key) != versions_.end()) {
+      bf_msgs::msg::BlackboardEntry current;
+      if (TypeRegistry::instance().encode(blackboard_, entry.key, &current) &&
+        same_value(current, entry))
+      {
+        continue;
+      }
+    }
+
+    if (!TypeRegistry::instance().decode(entry, blackboard_)) {
+      RCLCPP_ERROR(
+        get_logger(), "key %s could not be updated (type %d)", entry.key.c_str(), entry.type);
+      continue;
+    }
+    mark_dirty(entry.key, robot_id);
   }
+  apply_time_.record(
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - t_apply).count());
+
+  release_lease(robot_id);
+
+  commit(robot_id);
+  dispatch_grants();
+}
+
+void BlackboardManager::compare_and_swap()
+{
+  const std::string & robot_id = update_bb_msg_->robot_id;
+  bf_msgs::msg::Blackboard answ;
+  answ.robot_id = robot_id;
+
+  // the write is committed only if no key is leased to another robot and every
+  // version the robot saw is still the current one (0 for keys it never saw)
+  auto own_lease = leases_.find(robot_id);
+  bool owns_whole = own_lease != leases_.end() && own_lease->second.keys.empty();
+  bool whole_leased = n_whole_leases_ > (owns_whole ? 1 : 0);
+  for (const auto & entry : update_bb_msg_->entries) {
+    auto owner = key_owners_.find(entry.key);
+    auto version = versions_.find(entry.key);
+    uint64_t current = (version != versions_.end()) ? version->second : 0;
+
+    if (whole_leased || (owner != key_owners_.end() && owner->second != robot_id) ||
+      (current != entry.version))
+    {
+      bf_msgs::msg::BlackboardEntry conflict;
+      conflict.key = entry.key;
+      if (current > 0) {
+        TypeRegistry::instance().encode(blackboard_, entry.key, &conflict);
+      }
+      conflict.version = current;
+      answ.entries.push_back(std::move(conflict));
+    }
+  }
+
+  if (!answ.entries.empty()) {
+    counters_.rejected++;
+    BF_TRACE(
+      get_logger(), "CAS from %s rejected: %zu conflicting keys", robot_id.c_str(),
+      answ.entries.size());
+    answ.type = bf_msgs::msg::Blackboard::CONFLICT;
+    reply(answ);
+    return;
+  }
+
+  auto t_apply = std::chrono::steady_clock::now();
+  for (const auto & entry : update_bb_msg_->entries) {
+    bf_msgs::msg::BlackboardEntry current;
+    bool changed = !TypeRegistry::instance().encode(blackboard_, entry.key, &current) ||
+      !same_value(current, entry);
+
+    if (changed) {
+      if (!TypeRegistry::instance().decode(entry, blackboard_)) {
+        RCLCPP_ERROR(
+          get_logger(), "key %s could not be updated (type %d)", entry.key.c_str(), entry.type);
+        continue;
+      }
+      mark_dirty(entry.key, robot_id);
+    }
+
+    bf_msgs::msg::BlackboardEntry ack;
+    ack.key = entry.key;
+    ack.version = versions_[entry.key];
+    answ.entries.push_back(std::move(ack));
+  }
+  apply_time_.record(
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - t_apply).count());
+
+  counters_.updates++;
+  BF_TRACE(get_logger(), "CAS from %s committed", robot_id.c_str());
+  answ.type = bf_msgs::msg::Blackboard::ACK;
+
+  // the ACK goes out only once the write is in the log
+  commit(robot_id);
+  reply(answ);
+}
 
-  lock_ = false;
+void BlackboardManager::commit(const std::string & robot_id)
+{
+  // logged before anyone can see it
+  log_writes();
+
+  // the delta is tagged with its writer, unless several robots wrote in the same batch
+  robot_id_ = (n_commits_ == 0 || robot_id_ == robot_id) ? robot_id : "";
+  n_commits_++;
 
-  publish_blackboard();
+  if (commit_window_.count() == 0 ||
+    (commit_batch_size_ > 0 && n_commits_ >= commit_batch_size_))
+  {
+    publish_blackboard();
+  } else if (!timer_commit_) {
+    // group commit: the writes are already applied, only the publication waits
+    timer_commit_ = create_wall_timer(
+      commit_window_, with_state(&BlackboardManager::publish_blackboard), state_group_);
+  }
 }
 
 void BlackboardManager::publish_blackboard()
 {
-  if (!lock_) {
-    lock_ = true;
-    bf_msgs::msg::Blackboard msg;
-    std::vector<BT::StringView> string_views = blackboard_->getKeys();
+  if (!dirty_keys_.empty()) {
+    auto msg_ptr = std::make_unique<bf_msgs::msg::Blackboard>();
+    auto & msg = *msg_ptr;
+    std::unordered_map<std::string, std::string> changed;
+    changed.swap(dirty_keys_);
 
+    // delta: only the keys changed since the last publication
     msg.type = bf_msgs::msg::Blackboard::PUBLISH;
-    // msg.robot_id = "all";
-    if (sync_) {
-      RCLCPP_DEBUG(get_logger(), "responding to a synchronization request");
-      msg.robot_id = "all";
-      sync_ = false;
+    msg.robot_id = robot_id_;
+    msg.full_snapshot = false;
+    std::vector<std::string> keys;
+    keys.reserve(changed.size());
+    for (const auto & key : changed) {
+      keys.push_back(key.first);
+    }
+
+    encode_entries(keys, msg);
+    n_pub_++;
+    counters_.publications++;
+    BF_TRACE(get_logger(), "blackboard published (%d): %zu keys", n_pub_, msg.entries.size());
+    publish_interests(msg, changed);
+    publish(std::move(msg_ptr), data_pub_, compress_data());
+  }
+  robot_id_ = "";
+  n_commits_ = 0;
+  if (timer_commit_) {
+    timer_commit_->cancel();
+    timer_commit_.reset();
+  }
+}
+
+void BlackboardManager::encode_entries(
+  const std::vector<std::string> & keys,
+  bf_msgs::msg::Blackboard & msg)
+{
+  auto & types = TypeRegistry::instance();
+  msg.entries.reserve(msg.entries.size() + keys.size());
+  for (const auto & key : keys) {
+    bf_msgs::msg::BlackboardEntry entry;
+    if (types.encode(blackboard_, key, &entry)) {
+      entry.version = versions_[key];
+      BF_TRACE(get_logger(), "publishing key %s (%d)", key.c_str(), entry.type);
+      msg.entries.push_back(std::move(entry));
     } else {
-      msg.robot_id = robot_id_;
+      BF_TRACE(get_logger(), "key %s skipped", key.c_str());
     }
+  }
+}
 
-    std::vector<std::string> keys;
-    std::vector<std::string> values;
-    std::vector<std::string> types;
-
-    for (const auto & string_view : string_views) {
-      try {
-        keys.push_back(string_view.data());
-        values.push_back(blackboard_->get<std::string>(string_view.data()));
-        types.push_back(get_type(string_view.data()));
-        RCLCPP_DEBUG(
-          get_logger(), "publishing key %s (%s)", string_view.data(),
-          types.back().c_str());
-      } catch (const std::exception & e) {
-        RCLCPP_DEBUG(get_logger(), "key %s skipped", string_view.data());
+void BlackboardManager::register_interest(const bf_msgs::msg::Blackboard & sync)
+{
+  KeyFilter interest(sync.keys);
+  if (interest.empty()) {
+    interests_.erase(sync.robot_id);
+  } else {
+    interests_[sync.robot_id] = interest;
+  }
+  // the SYNC also negotiates the compression of what the robot receives
+  zstd_readers_[sync.robot_id] = codec_.readable_by(sync);
+
+  // the standby must know where to send the data if it takes over
+  if (!standby_ && !standby_name_.empty()) {
+    log_pub_->publish(sync);
+  }
+}
+
+void BlackboardManager::serve_sync(const std::string & robot_id)
+{
+  // the snapshot goes only to the requester, on its reply topic: the rest of the fleet
+  // is not disturbed by a robot (re)joining
+  auto interest = interests_.find(robot_id);
+  std::vector<std::string> keys;
+  for (const auto & string_view : blackboard_->getKeys()) {
+    std::string key(string_view);
+    if (interest == interests_.end() || interest->second.matches(key)) {
+      keys.push_back(key);
+    }
+  }
+  auto msg = std::make_unique<bf_msgs::msg::Blackboard>();
+  msg->type = bf_msgs::msg::Blackboard::PUBLISH;
+  msg->robot_id = "all";
+  msg->full_snapshot = true;
+  encode_entries(keys, *msg);
+  BF_TRACE(
+    get_logger(), "snapshot sent to %s: %zu keys", robot_id.c_str(), msg->entries.size());
+  publish(std::move(msg), reply_pub(robot_id), reads_payloads(robot_id));
+
+  // a standby joining gets the interests and compression negotiated so far
+  if (!standby_ && robot_id == standby_name_) {
+    for (const auto & robot : zstd_readers_) {
+      bf_msgs::msg::Blackboard sync;
+      sync.type = bf_msgs::msg::Blackboard::SYNC;
+      sync.robot_id = robot.first;
+      auto interest = interests_.find(robot.first);
+      if (interest != interests_.end()) {
+        sync.keys = interest->second.rules();
+      }
+      if (robot.second) {
+        codec_.advertise(sync);
       }
+      log_pub_->publish(sync);
     }
-    msg.keys = keys;
-    msg.values = values;
-    msg.key_types = types;
-    bb_pub_->publish(msg);
-    n_pub_++;
-    lock_ = false;
-    robot_id_ = "";
+  }
+}
 
-    RCLCPP_INFO(get_logger(), "blackboard published (%d)", n_pub_);
+void BlackboardManager::publish_interests(
+  const bf_msgs::msg::Blackboard & msg,
+  const std::unordered_map<std::string, std::string> & changed)
+{
+  // robots with an interest set get the changed keys they are interested in, plus their
+  // own writes (so they learn the new versions) on their reply topic. The writer is taken
+  // per key: a batch written by several robots is tagged with none of them
+  for (const auto & interest : interests_) {
+    auto delta = std::make_unique<bf_msgs::msg::Blackboard>();
+    delta->type = bf_msgs::msg::Blackboard::PUBLISH;
+    delta->robot_id = msg.robot_id;
+    delta->full_snapshot = false;
+    for (const auto & entry : msg.entries) {
+      auto writer = changed.find(entry.key);
+      if (writer != changed.end() &&
+        (writer->second == interest.first || interest.second.matches(entry.key)))
+      {
+        delta->entries.push_back(entry);
+      }
+    }
+    if (!delta->entries.empty()) {
+      publish(std::move(delta), reply_pub(interest.first), reads_payloads(interest.first));
+    }
   }
 }
 
-void BlackboardManager::copy_blackboard(BT::Blackboard::Ptr source_bb)
+rclcpp::Publisher<bf_msgs::msg::Blackboard>::SharedPtr
+BlackboardManager::reply_pub(const std::string & robot_id)
 {
+  auto it = reply_pubs_.find(robot_id);
+  if (it == reply_pubs_.end()) {
+    RCLCPP_DEBUG(get_logger(), "creating reply topic of %s", robot_id.c_str());
+    auto pub = create_publisher<bf_msgs::msg::Blackboard>(
+      shard_map_.reply_topic(shard_id_, robot_id), 100);
+    it = reply_pubs_.emplace(robot_id, pub).first;
+  }
+  return it->second;
+}
+
+void BlackboardManager::publish_stats()
+{
+  auto to_msg = [](LatencyHistogram & histogram) {
+      bf_msgs::msg::LatencyStats stats;
+      stats.count = histogram.count();
+      stats.mean = histogram.mean() * 1e3;
+      stats.p50 = histogram.percentile(50.0) * 1e3;
+      stats.p99 = histogram.percentile(99.0) * 1e3;
+      stats.p999 = histogram.percentile(99.9) * 1e3;
+      stats.max = histogram.max() * 1e3;
+      histogram.reset();
+      return stats;
+    };
+
+  rclcpp::Time now = rclcpp::Clock().now();
+  bf_msgs::msg::BlackboardStats msg;
+  msg.stamp = now;
+  msg.manager = get_name();
+  msg.shard = shard_id_;
+  msg.queue_depth = scheduler_.size();
+  msg.max_queue_depth = tam_q_;
+  msg.leases = leases_.size();
+  msg.publications = n_pub_;
+  msg.period = now - t_last_stats_;
+  msg.grant_wait = to_msg(grant_wait_);
+  msg.hold_time = to_msg(hold_time_);
+  msg.apply_time = to_msg(apply_time_);
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    msg.publish_time = to_msg(publish_time_);
+    msg.compress_time = to_msg(compress_time_);
+    msg.compressed_publications = n_compressed_;
+    msg.raw_bytes = raw_bytes_;
+    msg.compressed_bytes = compressed_bytes_;
+    msg.compression_ratio =
+      compressed_bytes_ > 0 ? static_cast<double>(raw_bytes_) / compressed_bytes_ : 0.0;
+  }
+  stats_pub_->publish(msg);
+  t_last_stats_ = now;
+}
+
+void BlackboardManager::log_summary()
+{
+  if (counters_.requests == 0 && counters_.updates == 0 && counters_.publications == 0) {
+    return;
+  }
+  RCLCPP_INFO(
+    get_logger(), "%d requests, %d grants, %d updates (%d rejected), %d publications; "
+    "queue %zu (max %d), %zu leases", counters_.requests, counters_.grants, counters_.updates,
+    counters_.rejected, counters_.publications, scheduler_.size(), tam_q_, leases_.size());
+  counters_ = Counters();
+}
+
+void BlackboardManager::reply(bf_msgs::msg::Blackboard & msg)
+{
+  codec_.advertise(msg);
+  msg.epoch = epoch_;
+  reply_pub(msg.robot_id)->publish(msg);
+}
+
+void BlackboardManager::mark_dirty(const std::string & key, const std::string & writer)
+{
+  versions_[key] = ++version_;
+  dirty_keys_[key] = writer;
+  if (store_.is_open() || !standby_name_.empty()) {
+    wal_keys_.push_back(key);
+  }
+}
+
+void BlackboardManager::recover_blackboard(const std::string & dir, bool sync)
+{
+  if (!store_.open(dir, sync)) {
+    RCLCPP_ERROR(
+      get_logger(), "blackboard store could not be opened in %s: %s", dir.c_str(),
+      std::strerror(errno));
+    return;
+  }
+
+  auto & types = TypeRegistry::instance();
+  size_t n_records = store_.recover(
+    [this, &types](const bf_msgs::msg::Blackboard & record) {
+      for (const auto & entry : record.entries) {
+        if (types.decode(entry, blackboard_)) {
+          versions_[entry.key] = entry.version;
+          version_ = std::max(version_, entry.version);
+        }
+      }
+    });
+  RCLCPP_INFO(
+    get_logger(), "blackboard store %s: %zu keys recovered from %zu records (version %lu)",
+    dir.c_str(), versions_.size(), n_records, version_);
+}
+
+void BlackboardManager::log_writes()
+{
+  if (wal_keys_.empty()) {
+    return;
+  }
+
+  bf_msgs::msg::Blackboard record;
+  record.type = bf_msgs::msg::Blackboard::PUBLISH;  // applied as such by the standby
+  record.epoch = epoch_;
+  auto & types = TypeRegistry::instance();
+  record.entries.reserve(wal_keys_.size());
+  for (const auto & key : wal_keys_) {
+    bf_msgs::msg::BlackboardEntry entry;
+    if (types.encode(blackboard_, key, &entry)) {
+      entry.version = versions_[key];
+      record.entries.push_back(std::move(entry));
+    }
+  }
+  wal_keys_.clear();
+
+  if (!standby_name_.empty()) {
+    log_pub_->publish(record);  // log shipping to the standby
+  }
+  if (!store_.is_open()) {
+    return;
+  }
+  if (!store_.append(record)) {
+    RCLCPP_ERROR(get_logger(), "write-ahead log append failed: %s", std::strerror(errno));
+    return;
+  }
+  n_wal_records_++;
+}
+
+void BlackboardManager::checkpoint_blackboard()
+{
+  if (n_wal_records_ == 0 && wal_keys_.empty()) {
+    return;
+  }
+
+  bf_msgs::msg::Blackboard snapshot;
+  snapshot.type = bf_msgs::msg::Blackboard::PUBLISH;
+  snapshot.full_snapshot = true;
+  auto & types = TypeRegistry::instance();
+  for (const auto & string_view : blackboard_->getKeys()) {
+    bf_msgs::msg::BlackboardEntry entry;
+    if (types.encode(blackboard_, string_view.data(), &entry)) {
+      entry.version = versions_[string_view.data()];
+      snapshot.entries.push_back(std::move(entry));
+    }
+  }
+
+  if (!store_.checkpoint(snapshot)) {
+    RCLCPP_ERROR(get_logger(), "blackboard checkpoint failed: %s", std::strerror(errno));
+    return;
+  }
+  RCLCPP_DEBUG(
+    get_logger(), "blackboard checkpoint: %zu keys (%d log records dropped)",
+    snapshot.entries.size(), n_wal_records_);
+  wal_keys_.clear();
+  n_wal_records_ = 0;
+}
+
+void BlackboardManager::set_role(bool standby)
+{
+  standby_ = standby;
+  synced_ = false;
+  known_to_primary_ = false;
+  standby_name_.clear();
+
+  if (standby_) {
+    rclcpp::SubscriptionOptions options;
+    options.callback_group = state_group_;
+    log_sub_ = create_subscription<bf_msgs::msg::Blackboard>(
+      shard_map_.log_topic(shard_id_), rclcpp::QoS(1000).reliable().transient_local(),
+      std::bind(&BlackboardManager::follow_primary, this, std::placeholders::_1), options);
+    // the full snapshot (SYNC answer) comes on its reply topic; from then on the (reliable)
+    // log carries every committed write
+    reply_sub_ = create_subscription<bf_msgs::msg::Blackboard>(
+      shard_map_.reply_topic(shard_id_, get_name()), rclcpp::SensorDataQoS().keep_last(100),
+      std::bind(&BlackboardManager::follow_primary, this, std::placeholders::_1), options);
+    sync_pub_ = create_publisher<bf_msgs::msg::Blackboard>(
+      shard_map_.requests_topic(shard_id_), 10);
+    t_primary_hb_ = rclcpp::Clock().now();
+  } else {
+    log_sub_.reset();
+    reply_sub_.reset();
+    sync_pub_.reset();
+  }
+}
+
+void BlackboardManager::heartbeat()
+{
+  rclcpp::Time now = rclcpp::Clock().now();
+
+  if (standby_ && !synced_) {
+    // ask the primary for a full snapshot until one arrives, once it ships its log to us
+    if (known_to_primary_) {
+      bf_msgs::msg::Blackboard sync;
+      sync.type = bf_msgs::msg::Blackboard::SYNC;
+      sync.robot_id = get_name();
+      codec_.advertise(sync);
+      sync_pub_->publish(sync);
+    }
+  } else if (standby_ && (now - t_primary_hb_).seconds() > failover_timeout_) {
+    take_over();
+  }
+
+  // keys: role, then the standby known by the primary or "synced" for a synced standby
+  bf_msgs::msg::Blackboard msg;
+  msg.type = bf_msgs::msg::Blackboard::HEARTBEAT;
+  msg.robot_id = get_name();
+  msg.keys.push_back(standby_ ? "standby" : "primary");
+  if (!standby_ && !standby_name_.empty()) {
+    msg.keys.push_back(standby_name_);
+  } else if (standby_ && synced_) {
+    msg.keys.push_back("synced");
+  }
+  msg.token = token_;
+  msg.epoch = epoch_;
+  heartbeat_pub_->publish(msg);
+}
+
+void BlackboardManager::heartbeat_callback(bf_msgs::msg::Blackboard::UniquePtr msg)
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  if (msg->robot_id == get_name() || msg->keys.empty()) {
+    return;
+  }
+
+  if (msg->keys[0] == "standby") {
+    // from now on the log is shipped; the standby answers SYNC once it is synchronized
+    if (!standby_) {
+      standby_name_ = msg->robot_id;
+    }
+    if (msg->keys.size() > 1 && msg->keys[1] == "synced") {
+      t_standby_hb_ = rclcpp::Clock().now();
+    }
+  } else if (standby_) {
+    t_primary_hb_ = rclcpp::Clock().now();
+    token_ = std::max(token_, msg->token);
+    if (msg->epoch != 0) {
+      epoch_ = msg->epoch;
+    }
+    known_to_primary_ = msg->keys.size() > 1 && msg->keys[1] == get_name();
+  } else if (msg->token > token_) {
+    step_down(*msg);
+  }
+}
+
+void BlackboardManager::step_down(const bf_msgs::msg::Blackboard & heartbeat)
+{
+  // a standby took over while this manager was unreachable: its leases are void, and so
+  // are the writes it committed but never shipped. The blackboard is taken again from
+  // the new primary
+  RCLCPP_WARN(
+    get_logger(), "%s is primary (token %lu > %lu): stepping down to standby",
+    heartbeat.robot_id.c_str(), heartbeat.token, token_);
+  leases_.clear();
+  key_owners_.clear();
+  n_whole_leases_ = 0;
+  scheduler_.clear();
+  dirty_keys_.clear();
+  wal_keys_.clear();
   blackboard_->clear();
+  versions_.clear();
+  if (store_.is_open()) {
+    bf_msgs::msg::Blackboard empty;
+    empty.type = bf_msgs::msg::Blackboard::PUBLISH;
+    empty.full_snapshot = true;
+    if (!store_.checkpoint(empty)) {
+      RCLCPP_ERROR(get_logger(), "blackboard store could not be cleared: %s", std::strerror(errno));
+    }
+    n_wal_records_ = 0;
+  }
+  token_ = heartbeat.token;
+  epoch_ = heartbeat.epoch;
+  set_role(true);
+}
+
+void BlackboardManager::follow_primary(bf_msgs::msg::Blackboard::UniquePtr msg)
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  if (standby_ && msg->type == bf_msgs::msg::Blackboard::SYNC) {
+    register_interest(*msg);  // shipped by the primary
+    return;
+  }
+  if (!standby_ || msg->type != bf_msgs::msg::Blackboard::PUBLISH) {
+    return;
+  }
+  if (!codec_.decompress(*msg)) {
+    RCLCPP_ERROR(get_logger(), "publication dropped: its payload cannot be decompressed");
+    return;
+  }
+  if (msg->epoch != 0) {
+    epoch_ = msg->epoch;  // served in the snapshots of the standby
+  }
+
+  bf_msgs::msg::Blackboard record;
+  auto & types = TypeRegistry::instance();
+  for (const auto & entry : msg->entries) {
+    auto version = versions_.find(entry.key);
+    if (version != versions_.end() && version->second >= entry.version) {
+      continue;
+    }
+    if (types.decode(entry, blackboard_)) {
+      versions_[entry.key] = entry.version;
+      version_ = std::max(version_, entry.version);
+      record.entries.push_back(entry);
+    }
+  }
+
+  if (msg->full_snapshot && !synced_) {
+    RCLCPP_INFO(get_logger(), "standby synchronized: %zu keys", versions_.size());
+    synced_ = true;
+  }
+  if (store_.is_open() && !record.entries.empty() && store_.append(record)) {
+    n_wal_records_++;
+  }
+}
+
+void BlackboardManager::take_over()
+{
+  RCLCPP_WARN(
+    get_logger(), "no heartbeat from the primary for %.3f s: taking over",
+    (rclcpp::Clock().now() - t_primary_hb_).seconds());
+  set_role(false);
+  synced_ = true;
+
+  // new fencing epoch: no token issued by the old primary can match a new lease. The
+  // versions get a new epoch too, above those the old primary may have sent but not shipped
+  token_ += (uint64_t(1) << 32);
+  new_epoch();
+
+  auto msg = std::make_unique<bf_msgs::msg::Blackboard>();
+  msg->type = bf_msgs::msg::Blackboard::FAILOVER;
+  msg->robot_id = get_name();
+  msg->token = token_;
+  for (const auto & interest : interests_) {
+    publish(std::make_unique<bf_msgs::msg::Blackboard>(*msg), reply_pub(interest.first));
+  }
+  publish(std::move(msg), data_pub_);
+}
+
+void BlackboardManager::new_epoch()
+{
+  // the epoch is the start time (s), or the next one if the clock is behind the epochs
+  // already seen, so a restarted manager counts versions above those of its previous run
+  uint64_t now = static_cast<uint64_t>(rclcpp::Clock().now().seconds());
+  uint64_t next = std::max<uint64_t>((version_ >> 32) + 1, uint64_t(epoch_) + 1);
+  epoch_ = static_cast<uint32_t>(std::max(now, next));
+  version_ = static_cast<uint64_t>(epoch_) << 32;
+  RCLCPP_INFO(get_logger(), "blackboard epoch %u", epoch_);
+}
+
+void BlackboardManager::copy_blackboard(BT::Blackboard::Ptr source_bb)
+{
+  // a standby gets the blackboard from the primary
+  if (standby_) {
+    return;
+  }
+
+  // keys recovered from the store are newer than the initial blackboard
+  bool recovered = !versions_.empty();
+  if (!recovered) {
+    blackboard_->clear();
+  }
 
+  auto & types = TypeRegistry::instance();
   std::vector<BT::StringView> string_views = source_bb->getKeys();
   for (const auto & string_view : string_views) {
-    try {
-      RCLCPP_DEBUG(get_logger(), "copying key %s", string_view.data());
+    std::string key(string_view);
+    RCLCPP_DEBUG(get_logger(), "copying key %s", key.c_str());
 
-      // check if the entry should be skipped
-      if (string_view.find("efbb_") != std::string::npos) {
-        RCLCPP_DEBUG(get_logger(), "key %s copy skipped", string_view.data());
-        continue;
-      }
-
-      std::string type = get_type(source_bb, string_view.data());
-      std::string val;
-      if (type == "int") {
-        int value = source_bb->get<int>(string_view.data());
-        blackboard_->set(string_view.data(), value);
-        val = std::to_string(value);
-      } else if (type == "float") {
-        float value = source_bb->get<float>(string_view.data());
-        blackboard_->set(string_view.data(), value);
-        val = std::to_string(value);
-      } else if (type == "double") {
-        double value = source_bb->get<double>(string_view.data());
-        blackboard_->set(string_view.data(), value);
-        val = std::to_string(value);
-      } else if (type == "string") {
-        std::string value = source_bb->get<std::string>(string_view.data());
-        blackboard_->set(string_view.data(), value);
-        val = value;
-      } else if (type == "bool") {
-        bool value = source_bb->get<bool>(string_view.data());
-        blackboard_->set(string_view.data(), value);
-        val = std::to_string(value);
-      } else {
-        throw std::runtime_error("unknown type");
-        // RCLCPP_ERROR(get_logger(), "unknown type [%s]", type.c_str());
-      }
+    // check if the entry should be skipped or belongs to another shard
+    if (!is_shared(key) || shard_map_.shard(key) != shard_id_ ||
+      (recovered && versions_.find(key) != versions_.end()))
+    {
+      RCLCPP_DEBUG(get_logger(), "key %s copy skipped", key.c_str());
+      continue;
+    }
 
-      RCLCPP_DEBUG(get_logger(), "key %s copied", string_view.data());
-      RCLCPP_DEBUG(get_logger(), "key %s value is: %s", string_view.data(), val.c_str());
-      RCLCPP_DEBUG(
-        get_logger(), "key %s type is: %s", string_view.data(),
-        get_type(string_view.data()).c_str());
-    } catch (const std::exception & e) {
-      RCLCPP_DEBUG(get_logger(), "key %s copy skipped", string_view.data());
+    // keys of types that cannot be shared are left out
+    bf_msgs::msg::BlackboardEntry entry;
+    if (!types.encode(source_bb, key, &entry) || !types.decode(entry, blackboard_)) {
+      RCLCPP_DEBUG(get_logger(), "key %s copy skipped", key.c_str());
+      continue;
     }
+
+    mark_dirty(key);
+    RCLCPP_DEBUG(get_logger(), "key %s copied (type %d)", key.c_str(), entry.type);
   }
+  log_writes();
+}
+
+bool BlackboardManager::is_shared(const std::string & key) const
+{
+  return !exclude_keys_.matches(key) && (include_keys_.empty() || include_keys_.matches(key));
 }
 
 void BlackboardManager::dump_blackboard()
@@ -314,9 +1334,11 @@ void BlackboardManager::dump_waiting_times()
   std::ofstream file(filename, std::ofstream::out);
 
   if (file.is_open()) {
-    for (const auto & wt : waiting_times_) {
-      file << (wt.nanoseconds() / 1e6) << std::endl;
-    }
+    // one line per histogram bucket: waiting time (ms):number of grants
+    grant_wait_total_.for_each(
+      [&file](double wait, uint64_t count) {
+        file << (wait * 1e3) << ":" << count << std::endl;
+      });
 
     // last lines of the file is the maximum size of the queue and the number of bb pubs
     file << tam_q_ << std::endl;
@@ -327,71 +1349,29 @@ void BlackboardManager::dump_waiting_times()
   } else {
     RCLCPP_INFO(get_logger(), "waiting times could NOT be dumped to file: %s", filename.c_str());
   }
-}
-
-std::string BlackboardManager::get_type(BT::Blackboard::Ptr bb, const char * port_name)
-{
 
-  const BT::PortInfo * port = bb->portInfo(port_name);
-  // thirdparty library updated, so this is not working anymore. Not tested
-  // const BT::TypeInfo * port = bb->entryInfo(port_name);
-
-  int status;
-  char * port_type = abi::__cxa_demangle(port->type().name(), nullptr, nullptr, &status);
-  std::string type(port_type);
-  std::free(port_type);
-
-  if (type.find("Any") != std::string::npos) {
-    return "string";
-  }
-  if (type.find("string") != std::string::npos) {
-    return "string";
-  }
-  if (type.find("int") != std::string::npos) {
-    return "int";
-  }
-  if (type.find("float") != std::string::npos) {
-    return "float";
-  }
-  if (type.find("double") != std::string::npos) {
-    return "double";
-  }
-  if (type.find("bool") != std::string::npos) {
-    return "bool";
-  }
-  return "unknown";
+  dump_hold_times();
 }
 
-std::string BlackboardManager::get_type(const char * port_name)
+void BlackboardManager::dump_hold_times()
 {
+  RCLCPP_INFO(get_logger(), "dumping lock hold times");
+  std::string filename = "results/hold_times.txt";
+  std::ofstream file(filename, std::ofstream::out);
 
-  const BT::PortInfo * port = blackboard_->portInfo(port_name);
-  // thirdparty library updated, so this is not working anymore. Not tested
-  // const BT::TypeInfo * port = blackboard_->entryInfo(port_name);
-  int status;
-  char * port_type = abi::__cxa_demangle(port->type().name(), nullptr, nullptr, &status);
-  std::string type(port_type);
-  std::free(port_type);
+  if (file.is_open()) {
+    // robot:leases:revoked:avg hold time (ms):max hold time (ms)
+    for (const auto & stats : hold_stats_) {
+      file << stats.first << ":" << stats.second.n_leases << ":" << stats.second.n_revoked <<
+        ":" << (stats.second.total / stats.second.n_leases) * 1e3 << ":" <<
+        stats.second.max * 1e3 << std::endl;
+    }
 
-  if (type.find("Any") != std::string::npos) {
-    return "string";
-  }
-  if (type.find("string") != std::string::npos) {
-    return "string";
-  }
-  if (type.find("int") != std::string::npos) {
-    return "int";
-  }
-  if (type.find("float") != std::string::npos) {
-    return "float";
-  }
-  if (type.find("double") != std::string::npos) {
-    return "double";
-  }
-  if (type.find("bool") != std::string::npos) {
-    return "bool";
+    file.close();
+    RCLCPP_INFO(get_logger(), "hold times dumped to file: %s", filename.c_str());
+  } else {
+    RCLCPP_INFO(get_logger(), "hold times could NOT be dumped to file: %s", filename.c_str());
   }
-  return "unknown";
 }
 
 }  // namespace BF
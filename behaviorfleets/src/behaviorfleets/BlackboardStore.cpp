@@ -0,0 +1,235 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include "behaviorfleets/BlackboardStore.hpp"
+
+namespace BF
+{
+
+namespace
+{
+
+// record layout: uint32 length and uint32 CRC-32 of the serialized message, followed by it
+constexpr size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+
+uint32_t crc32(const uint8_t * data, size_t size)
+{
+  static const auto table = []() {
+      std::array<uint32_t, 256> table;
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int bit = 0; bit < 8; bit++) {
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+      }
+      return table;
+    }();
+
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+void write_header(uint8_t * header, const uint8_t * data, uint32_t length)
+{
+  uint32_t crc = crc32(data, length);
+  std::memcpy(header, &length, sizeof(length));
+  std::memcpy(header + sizeof(length), &crc, sizeof(crc));
+}
+
+// the rename of a file is only durable once its directory is synced
+bool sync_dir(const std::string & dir)
+{
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+}  // namespace
+
+BlackboardStore::BlackboardStore()
+: wal_fd_(-1),
+  sync_(true)
+{
+}
+
+BlackboardStore::~BlackboardStore()
+{
+  if (wal_fd_ >= 0) {
+    ::close(wal_fd_);
+  }
+}
+
+bool BlackboardStore::open(const std::string & dir, bool sync)
+{
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    return false;
+  }
+
+  sync_ = sync;
+  dir_ = dir;
+  wal_path_ = dir + "/blackboard.wal";
+  checkpoint_path_ = dir + "/blackboard.ckpt";
+  wal_fd_ = ::open(wal_path_.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  return wal_fd_ >= 0;
+}
+
+size_t BlackboardStore::recover(
+  const std::function<void(const bf_msgs::msg::Blackboard &)> & apply)
+{
+  return replay(checkpoint_path_, apply) + replay(wal_path_, apply);
+}
+
+size_t BlackboardStore::replay(
+  const std::string & path,
+  const std::function<void(const bf_msgs::msg::Blackboard &)> & apply)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return 0;
+  }
+
+  size_t size = st.st_size;
+  void * data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return 0;
+  }
+
+  const uint8_t * bytes = static_cast<const uint8_t *>(data);
+  size_t offset = 0, n_records = 0;
+  while (offset + HEADER_SIZE <= size) {
+    uint32_t length, crc;
+    std::memcpy(&length, bytes + offset, sizeof(length));
+    std::memcpy(&crc, bytes + offset + sizeof(length), sizeof(crc));
+    if (length > size - offset - HEADER_SIZE) {
+      break;  // torn write at the end of the log
+    }
+    if (crc32(bytes + offset + HEADER_SIZE, length) != crc) {
+      break;  // torn or corrupted record: nothing after it can be trusted
+    }
+
+    rclcpp::SerializedMessage serialized(length);
+    auto & raw = serialized.get_rcl_serialized_message();
+    std::memcpy(raw.buffer, bytes + offset + HEADER_SIZE, length);
+    raw.buffer_length = length;
+
+    bf_msgs::msg::Blackboard record;
+    try {
+      serializer_.deserialize_message(&serialized, &record);
+    } catch (const std::exception & e) {
+      break;  // corrupted record: nothing after it can be trusted
+    }
+    apply(record);
+
+    offset += HEADER_SIZE + length;
+    n_records++;
+  }
+
+  ::munmap(data, size);
+  return n_records;
+}
+
+bool BlackboardStore::append(const bf_msgs::msg::Blackboard & record)
+{
+  if (wal_fd_ < 0) {
+    return false;
+  }
+
+  rclcpp::SerializedMessage serialized;
+  serializer_.serialize_message(&record, &serialized);
+  const auto & raw = serialized.get_rcl_serialized_message();
+  uint32_t length = raw.buffer_length;
+
+  // a single write, so that a crash can only leave a torn record at the very end
+  std::string buffer(HEADER_SIZE + length, '\0');
+  uint8_t * bytes = reinterpret_cast<uint8_t *>(buffer.data());
+  write_header(bytes, raw.buffer, length);
+  std::memcpy(bytes + HEADER_SIZE, raw.buffer, length);
+  if (::write(wal_fd_, buffer.data(), buffer.size()) != static_cast<ssize_t>(buffer.size())) {
+    return false;
+  }
+  return !sync_ || ::fdatasync(wal_fd_) == 0;
+}
+
+bool BlackboardStore::checkpoint(const bf_msgs::msg::Blackboard & snapshot)
+{
+  if (wal_fd_ < 0) {
+    return false;
+  }
+
+  rclcpp::SerializedMessage serialized;
+  serializer_.serialize_message(&snapshot, &serialized);
+  const auto & raw = serialized.get_rcl_serialized_message();
+  uint32_t length = raw.buffer_length;
+  size_t size = HEADER_SIZE + length;
+
+  std::string tmp_path = checkpoint_path_ + ".tmp";
+  int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  if (::ftruncate(fd, size) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void * data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  uint8_t * bytes = static_cast<uint8_t *>(data);
+  write_header(bytes, raw.buffer, length);
+  std::memcpy(bytes + HEADER_SIZE, raw.buffer, length);
+  bool ok = ::msync(data, size, MS_SYNC) == 0;
+  ::munmap(data, size);
+  ok = ok && ::fsync(fd) == 0;  // the size set by ftruncate too
+  ::close(fd);
+
+  // the new checkpoint replaces the old one atomically; the log is dropped only once the
+  // rename is on disk, or a crash could leave neither
+  if (!ok || ::rename(tmp_path.c_str(), checkpoint_path_.c_str()) != 0 || !sync_dir(dir_)) {
+    return false;
+  }
+  return ::ftruncate(wal_fd_, 0) == 0 && (!sync_ || ::fdatasync(wal_fd_) == 0);
+}
+
+}  // namespace BF
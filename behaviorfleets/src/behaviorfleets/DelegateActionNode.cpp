@@ -52,7 +52,7 @@ DelegateActionNode::DelegateActionNode(
   RCLCPP_INFO(node_->get_logger(), "plugins to propagate: %ld", plugins_.size());
 
   for (const auto & str : plugins_) {
-    RCLCPP_DEBUG(node_->get_logger(), str.c_str());
+    RCLCPP_DEBUG(node_->get_logger(), "plugin: %s", str.c_str());
   }
 
   RCLCPP_DEBUG(node_->get_logger(), "remote tree: %s", remote_tree_.c_str());
@@ -121,9 +121,9 @@ DelegateActionNode::remote_status_callback(bf_msgs::msg::Mission::UniquePtr msg)
   if (msg->source_id != me_) {
     return;
   }
-  RCLCPP_DEBUG(
-    node_->get_logger(), (std::string("remote status received: ") +
-    "[ " + msg->robot_id + " : " + msg->mission_id + " ]").c_str());
+  BF_TRACE(
+    node_->get_logger(), "remote status received: [ %s : %s ]", msg->robot_id.c_str(),
+    msg->mission_id.c_str());
 
   remote_status_ = std::move(msg);
   t_last_status_ = node_->now();
@@ -137,17 +137,16 @@ DelegateActionNode::mission_poll_callback(bf_msgs::msg::Mission::UniquePtr msg)
   }
 
   RCLCPP_INFO(
-    node_->get_logger(), (std::string("(" + me_ + ") REQUEST received: ") +
-    "[ " + msg->robot_id + " : " + msg->mission_id + " ]").c_str());
+    node_->get_logger(), "(%s) REQUEST received: [ %s : %s ]", me_.c_str(),
+    msg->robot_id.c_str(), msg->mission_id.c_str());
   // ignore answers from other robots
   if (!remote_identified_) {
-    RCLCPP_INFO(
-      node_->get_logger(), ("(%s) remote not yet identified", me_.c_str()));
+    RCLCPP_INFO(node_->get_logger(), "(%s) remote not yet identified", me_.c_str());
     // check if the remote should be excluded
     if (is_remote_excluded(msg->robot_id)) {
       RCLCPP_INFO(
-        node_->get_logger(), (std::string(" (" + me_ + ") remote excluded: ") +
-        "[ " + msg->robot_id + " ]").c_str());
+        node_->get_logger(), "(%s) remote excluded: [ %s ]", me_.c_str(),
+        msg->robot_id.c_str());
       // publish a negative answer
       bf_msgs::msg::Mission reject_msg;
       reject_msg.msg_type = bf_msgs::msg::Mission::REJECT;
@@ -161,8 +160,8 @@ DelegateActionNode::mission_poll_callback(bf_msgs::msg::Mission::UniquePtr msg)
     poll_answ_ = std::move(msg);
     remote_id_ = poll_answ_->robot_id;
     RCLCPP_INFO(
-      node_->get_logger(), (std::string("(" + me_ + ") remote identified: ") +
-      "[ " + remote_id_ + " : " + poll_answ_->mission_id + " ]").c_str());
+      node_->get_logger(), "(%s) remote identified: [ %s : %s ]", me_.c_str(),
+      remote_id_.c_str(), poll_answ_->mission_id.c_str());
 
     // '/' removed from topics to make it work with namespaces
 
@@ -225,7 +224,7 @@ DelegateActionNode::tick()
     poll_pub_->publish(msg);
 
     t_last_poll_ = node_->now();
-    RCLCPP_DEBUG(
+    BF_TRACE(
       node_->get_logger(), "OFFER sent (me: %s - mission: %s)",
       me_.c_str(), mission_id_.c_str());
   } else {
@@ -233,18 +232,15 @@ DelegateActionNode::tick()
       auto elapsed = node_->now() - t_last_status_;
       if ((elapsed.seconds() > timeout_) && (timeout_ != -1)) {
         RCLCPP_INFO(
-          node_->get_logger(), (std::string("remote ") + "[ " + remote_id_ + " ] " +
-          "TIMED OUT: looking for a new one").c_str());
+          node_->get_logger(), "remote [ %s ] TIMED OUT: looking for a new one",
+          remote_id_.c_str());
         n_tries_++;
         reset();
-        RCLCPP_INFO(
-          node_->get_logger(), std::string(
-            "tries: " + std::to_string(n_tries_) +
-            " / " + std::to_string(MAX_TRIES_)).c_str());
+        RCLCPP_INFO(node_->get_logger(), "tries: %d / %d", n_tries_, MAX_TRIES_);
         if ((n_tries_ >= MAX_TRIES_) && (MAX_TRIES_ != -1)) {
           RCLCPP_INFO(
-            node_->get_logger(), (std::string("remote ") + "[ " + remote_id_ + " ] " +
-            "timed out: max number of tries reached").c_str());
+            node_->get_logger(), "remote [ %s ] timed out: max number of tries reached",
+            remote_id_.c_str());
           n_tries_ = 0;
           return BT::NodeStatus::FAILURE;
         }
@@ -252,29 +248,23 @@ DelegateActionNode::tick()
         int status = remote_status_->status;
         switch (status) {
           case bf_msgs::msg::Mission::RUNNING:
-            RCLCPP_DEBUG(
-              node_->get_logger(), (std::string("remote status ") +
-              "[ " + remote_id_ + " ]: " + "RUNNING").c_str());
+            BF_TRACE(node_->get_logger(), "remote status [ %s ]: RUNNING", remote_id_.c_str());
             return BT::NodeStatus::RUNNING;
             break;
           case bf_msgs::msg::Mission::SUCCESS:
             RCLCPP_INFO(
-              node_->get_logger(), (std::string("remote status ") +
-              "[ " + remote_id_ + " ]: " + "***** SUCCESS *****").c_str());
+              node_->get_logger(), "remote status [ %s ]: ***** SUCCESS *****",
+              remote_id_.c_str());
             reset();
             return BT::NodeStatus::SUCCESS;
             break;
           case bf_msgs::msg::Mission::FAILURE:
-            RCLCPP_INFO(
-              node_->get_logger(), (std::string("remote status ") +
-              "[ " + remote_id_ + " ]: " + "FAILURE").c_str());
+            RCLCPP_INFO(node_->get_logger(), "remote status [ %s ]: FAILURE", remote_id_.c_str());
             reset();
             return BT::NodeStatus::FAILURE;
             break;
           case bf_msgs::msg::Mission::IDLE:
-            RCLCPP_DEBUG(
-              node_->get_logger(), (std::string("remote status ") +
-              "[ " + remote_id_ + " ]: " + "IDLE").c_str());
+            RCLCPP_DEBUG(node_->get_logger(), "remote status [ %s ]: IDLE", remote_id_.c_str());
             reset();
             break;
         }
@@ -283,8 +273,10 @@ DelegateActionNode::tick()
       auto elapsed = node_->now() - t_last_poll_;
       if ((elapsed.seconds() > poll_timeout_)) {
         RCLCPP_INFO(
-          node_->get_logger(), (std::string("(" + me_ + ") remote ") + "[ " + remote_id_ + " ] " +
-          "requested a mission, but NEVER reported status: looking for a new one").c_str());
+          node_->get_logger(),
+          "(%s) remote [ %s ] requested a mission, but NEVER reported status: "
+          "looking for a new one",
+          me_.c_str(), remote_id_.c_str());
         remote_identified_ = false;
       }
     }
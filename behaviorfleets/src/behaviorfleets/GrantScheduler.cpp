@@ -0,0 +1,130 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "behaviorfleets/GrantScheduler.hpp"
+
+namespace BF
+{
+
+GrantScheduler::GrantScheduler(const std::vector<std::string> & weight_rules)
+: vtime_(0.0),
+  seq_(0)
+{
+  // malformed rules and non positive weights are ignored
+  for (const auto & rule : weight_rules) {
+    size_t sep = rule.rfind('=');
+    if (sep == std::string::npos || sep == 0) {
+      continue;
+    }
+    char * end;
+    double weight = std::strtod(rule.c_str() + sep + 1, &end);
+    if (*end != '\0' || end == rule.c_str() + sep + 1 || weight <= 0.0) {
+      continue;
+    }
+    weights_[rule.substr(0, sep)] = weight;
+  }
+}
+
+double GrantScheduler::weight(const std::string & robot_id) const
+{
+  auto it = weights_.find(robot_id);
+  return (it != weights_.end()) ? it->second : 1.0;
+}
+
+bool GrantScheduler::Order::operator()(const Request & a, const Request & b) const
+{
+  if (a.priority != b.priority) {
+    return a.priority > b.priority;
+  }
+  bool a_deadline = a.deadline.nanoseconds() > 0;
+  bool b_deadline = b.deadline.nanoseconds() > 0;
+  if (a_deadline != b_deadline) {
+    return a_deadline;
+  }
+  if (a_deadline && a.deadline != b.deadline) {
+    return a.deadline < b.deadline;
+  }
+  if (a.pass != b.pass) {
+    return a.pass < b.pass;
+  }
+  return a.seq < b.seq;
+}
+
+const GrantScheduler::Request * GrantScheduler::find(const std::string & robot_id) const
+{
+  auto entry = index_.find(robot_id);
+  return (entry != index_.end()) ? &*entry->second : nullptr;
+}
+
+bool GrantScheduler::push(const Request & request)
+{
+  auto entry = index_.find(request.robot_id);
+
+  if (entry == index_.end()) {
+    Request r = request;
+    r.seq = seq_++;
+    // a robot that was idle does not keep credit from the past
+    auto pass = pass_.find(r.robot_id);
+    r.pass = (pass != pass_.end()) ? std::max(pass->second, vtime_) : vtime_;
+    auto queued = q_.insert(std::move(r)).first;
+    index_.emplace(queued->robot_id, queued);
+    return true;
+  }
+
+  // repeated REQUEST (e.g. after a timeout): keep the place in the queue (seq and pass) and
+  // widen it. Priority and deadline may move it, so it is taken out and sorted in again
+  auto node = q_.extract(entry->second);
+  Request * queued = &node.value();
+  if (queued->keys.empty() || request.keys.empty()) {
+    queued->keys.clear();
+  } else {
+    std::unordered_set<std::string> keys(queued->keys.begin(), queued->keys.end());
+    for (const auto & key : request.keys) {
+      if (keys.insert(key).second) {
+        queued->keys.push_back(key);
+      }
+    }
+  }
+  queued->priority = std::max(queued->priority, request.priority);
+  if (request.deadline.nanoseconds() > 0 &&
+    (queued->deadline.nanoseconds() == 0 || request.deadline < queued->deadline))
+  {
+    queued->deadline = request.deadline;
+  }
+  entry->second = q_.insert(std::move(node)).position;
+  return false;
+}
+
+void GrantScheduler::pop(const std::string & robot_id)
+{
+  auto entry = index_.find(robot_id);
+  if (entry == index_.end()) {
+    return;
+  }
+
+  // robot_id may be the one of the request: the request is erased last
+  auto it = entry->second;
+  vtime_ = std::max(vtime_, it->pass);
+  pass_[robot_id] = it->pass + 1.0 / weight(robot_id);
+  index_.erase(entry);
+  q_.erase(it);
+}
+
+}  // namespace BF
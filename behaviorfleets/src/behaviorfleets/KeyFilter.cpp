@@ -0,0 +1,101 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "behaviorfleets/KeyFilter.hpp"
+
+namespace BF
+{
+
+KeyFilter::KeyFilter(const std::vector<std::string> & rules)
+{
+  for (const auto & rule : rules) {
+    if (rule.empty()) {
+      continue;
+    }
+    rules_.push_back(rule);
+    size_t wildcard = rule.find_first_of("*?");
+    if (wildcard == std::string::npos) {
+      keys_.insert(rule);
+    } else if (wildcard == rule.size() - 1 && rule.back() == '*') {
+      std::string prefix = rule.substr(0, wildcard);
+      prefixes_.emplace(std::hash<std::string_view>()(prefix), prefix);
+      if (std::find(prefix_lengths_.begin(), prefix_lengths_.end(), wildcard) ==
+        prefix_lengths_.end())
+      {
+        prefix_lengths_.push_back(wildcard);
+      }
+    } else {
+      globs_.push_back(rule);
+    }
+  }
+}
+
+bool KeyFilter::matches(const std::string & key) const
+{
+  if (keys_.find(key) != keys_.end()) {
+    return true;
+  }
+  std::string_view view(key);
+  for (size_t length : prefix_lengths_) {
+    if (length > key.size()) {
+      continue;
+    }
+    std::string_view head = view.substr(0, length);
+    auto candidates = prefixes_.equal_range(std::hash<std::string_view>()(head));
+    for (auto prefix = candidates.first; prefix != candidates.second; ++prefix) {
+      if (prefix->second == head) {
+        return true;
+      }
+    }
+  }
+  for (const auto & glob : globs_) {
+    if (glob_match(glob, key)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool KeyFilter::glob_match(const std::string & glob, const std::string & key)
+{
+  // greedy match, backtracking to the last '*' on a mismatch
+  size_t g = 0, k = 0;
+  size_t star = std::string::npos, star_k = 0;
+  while (k < key.size()) {
+    if (g < glob.size() && (glob[g] == '?' || glob[g] == key[k])) {
+      g++;
+      k++;
+    } else if (g < glob.size() && glob[g] == '*') {
+      star = g++;
+      star_k = k;
+    } else if (star != std::string::npos) {
+      g = star + 1;
+      k = ++star_k;
+    } else {
+      return false;
+    }
+  }
+  while (g < glob.size() && glob[g] == '*') {
+    g++;
+  }
+  return g == glob.size();
+}
+
+}  // namespace BF
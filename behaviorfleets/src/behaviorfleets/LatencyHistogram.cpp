@@ -0,0 +1,103 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+
+#include "behaviorfleets/LatencyHistogram.hpp"
+
+namespace BF
+{
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+void LatencyHistogram::reset()
+{
+  counts_.fill(0);
+  count_ = 0;
+  max_us_ = 0;
+  sum_us_ = 0.0;
+}
+
+size_t LatencyHistogram::index(uint64_t us)
+{
+  if (us < SUB_BUCKETS) {
+    return us;
+  }
+  int shift = 63 - __builtin_clzll(us) - SUB_BITS;
+  if (shift > MAX_SHIFT) {
+    return N_BUCKETS - 1;
+  }
+  return (shift + 1) * SUB_BUCKETS + ((us >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::lowest(size_t index)
+{
+  if (index < SUB_BUCKETS) {
+    return index;
+  }
+  int shift = index / SUB_BUCKETS - 1;
+  return (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::width(size_t index)
+{
+  return (index < SUB_BUCKETS) ? 1 : (uint64_t(1) << (index / SUB_BUCKETS - 1));
+}
+
+void LatencyHistogram::record(double seconds)
+{
+  uint64_t us = (seconds > 0.0) ? static_cast<uint64_t>(std::llround(seconds * 1e6)) : 0;
+  counts_[index(us)]++;
+  count_++;
+  max_us_ = std::max(max_us_, us);
+  sum_us_ += us;
+}
+
+double LatencyHistogram::mean() const
+{
+  return (count_ > 0) ? (sum_us_ / count_) / 1e6 : 0.0;
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+  if (count_ == 0) {
+    return 0.0;
+  }
+
+  // highest value of the bucket holding the requested rank, never above the real maximum
+  uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * count_)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < N_BUCKETS; i++) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(lowest(i) + width(i) - 1, max_us_) / 1e6;
+    }
+  }
+  return max_us_ / 1e6;
+}
+
+void LatencyHistogram::for_each(const std::function<void(double, uint64_t)> & f) const
+{
+  for (size_t i = 0; i < N_BUCKETS; i++) {
+    if (counts_[i] > 0) {
+      f((lowest(i) + width(i) / 2.0) / 1e6, counts_[i]);
+    }
+  }
+}
+
+}  // namespace BF
@@ -0,0 +1,186 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <zstd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "behaviorfleets/PayloadCodec.hpp"
+
+namespace BF
+{
+
+namespace
+{
+
+using bf_msgs::msg::Blackboard;
+
+// larger payloads are rejected instead of decompressed
+constexpr size_t MAX_DECOMPRESSED_SIZE = 64 * 1024 * 1024;
+
+// bytes the entries take on the wire, roughly
+size_t entries_size(const Blackboard & msg)
+{
+  size_t size = 0;
+  for (const auto & entry : msg.entries) {
+    size += 32 + entry.key.size() + entry.string_value.size() + entry.bytes_value.size() +
+      entry.type_name.size();
+  }
+  return size;
+}
+
+// one compression and one decompression context per thread
+ZSTD_CCtx * cctx()
+{
+  thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx *)> ctx(
+    ZSTD_createCCtx(), ZSTD_freeCCtx);
+  return ctx.get();
+}
+
+ZSTD_DCtx * dctx()
+{
+  thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> ctx(
+    ZSTD_createDCtx(), ZSTD_freeDCtx);
+  return ctx.get();
+}
+
+}  // namespace
+
+PayloadCodec::PayloadCodec(size_t threshold, const std::string & dictionary, int level)
+: threshold_(threshold),
+  level_(level),
+  dictionary_failed_(false),
+  dictionary_id_(0)
+{
+  if (dictionary.empty()) {
+    return;
+  }
+
+  std::ifstream file(dictionary, std::ios::binary);
+  std::vector<char> bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  ZSTD_CDict * cdict = nullptr;
+  ZSTD_DDict * ddict = nullptr;
+  if (!bytes.empty()) {
+    cdict = ZSTD_createCDict(bytes.data(), bytes.size(), level);
+    ddict = ZSTD_createDDict(bytes.data(), bytes.size());
+  }
+  if (cdict == nullptr || ddict == nullptr) {
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+    dictionary_failed_ = true;
+    threshold_ = 0;
+    return;
+  }
+  cdict_ = std::shared_ptr<ZSTD_CDict>(cdict, ZSTD_freeCDict);
+  ddict_ = std::shared_ptr<ZSTD_DDict>(ddict, ZSTD_freeDDict);
+  dictionary_id_ = ZSTD_getDictID_fromDict(bytes.data(), bytes.size());
+}
+
+void PayloadCodec::advertise(Blackboard & msg) const
+{
+  msg.accepts_zstd = !dictionary_failed_;
+  msg.dictionary_id = dictionary_id_;
+}
+
+bool PayloadCodec::readable_by(const Blackboard & msg) const
+{
+  return msg.accepts_zstd && msg.dictionary_id == dictionary_id_;
+}
+
+size_t PayloadCodec::compress(Blackboard & msg) const
+{
+  if (!enabled() || msg.compression != Blackboard::COMPRESSION_NONE ||
+    entries_size(msg) < threshold_)
+  {
+    return 0;
+  }
+
+  Blackboard entries;
+  entries.entries = std::move(msg.entries);
+  rclcpp::SerializedMessage serialized;
+  rclcpp::Serialization<Blackboard>().serialize_message(&entries, &serialized);
+  const auto & raw = serialized.get_rcl_serialized_message();
+
+  msg.payload.resize(ZSTD_compressBound(raw.buffer_length));
+  size_t size;
+  if (cdict_) {
+    size = ZSTD_compress_usingCDict(
+      cctx(), msg.payload.data(), msg.payload.size(), raw.buffer, raw.buffer_length,
+      cdict_.get());
+  } else {
+    size = ZSTD_compressCCtx(
+      cctx(), msg.payload.data(), msg.payload.size(), raw.buffer, raw.buffer_length, level_);
+  }
+
+  // not worth it: the entries go as they are
+  if (ZSTD_isError(size) || size >= raw.buffer_length) {
+    msg.entries = std::move(entries.entries);
+    msg.payload.clear();
+    return 0;
+  }
+  msg.payload.resize(size);
+  msg.compression = Blackboard::COMPRESSION_ZSTD;
+  return raw.buffer_length;
+}
+
+bool PayloadCodec::decompress(Blackboard & msg) const
+{
+  if (msg.compression == Blackboard::COMPRESSION_NONE) {
+    return true;
+  }
+  if (msg.compression != Blackboard::COMPRESSION_ZSTD) {
+    return false;
+  }
+
+  unsigned long long length =  // NOLINT(runtime/int)
+    ZSTD_getFrameContentSize(msg.payload.data(), msg.payload.size());
+  if (length == ZSTD_CONTENTSIZE_UNKNOWN || length == ZSTD_CONTENTSIZE_ERROR ||
+    length > MAX_DECOMPRESSED_SIZE)
+  {
+    return false;
+  }
+
+  rclcpp::SerializedMessage serialized(length);
+  auto & raw = serialized.get_rcl_serialized_message();
+  size_t size;
+  if (ddict_) {
+    size = ZSTD_decompress_usingDDict(
+      dctx(), raw.buffer, length, msg.payload.data(), msg.payload.size(), ddict_.get());
+  } else {
+    size = ZSTD_decompressDCtx(
+      dctx(), raw.buffer, length, msg.payload.data(), msg.payload.size());
+  }
+  if (ZSTD_isError(size) || size != length) {
+    return false;  // e.g. made with another dictionary
+  }
+  raw.buffer_length = size;
+
+  Blackboard entries;
+  try {
+    rclcpp::Serialization<Blackboard>().deserialize_message(&serialized, &entries);
+  } catch (const std::exception & e) {
+    return false;
+  }
+  msg.entries = std::move(entries.entries);
+  msg.payload.clear();
+  msg.compression = Blackboard::COMPRESSION_NONE;
+  return true;
+}
+
+}  // namespace BF
@@ -14,6 +14,8 @@
 
 #include "behaviorfleets/RemoteDelegateActionNode.hpp"
 #include <algorithm>
+#include <functional>
+#include <set>
 
 namespace BF
 {
@@ -45,7 +47,7 @@ RemoteDelegateActionNode::init()
     "/mission_poll", rclcpp::SensorDataQoS(),
     std::bind(&RemoteDelegateActionNode::mission_poll_callback, this, std::placeholders::_1));
 
-  RCLCPP_INFO(get_logger(), ("[ " + id_ + " ] " + "subscribed to /mission_poll").c_str());
+  RCLCPP_INFO(get_logger(), "[ %s ] subscribed to /mission_poll", id_.c_str());
 
 
   std::string ns = get_namespace();
@@ -70,7 +72,7 @@ RemoteDelegateActionNode::init()
 
 
   RCLCPP_INFO(
-    get_logger(), ("[ " + id_ + " ] " + "subscribed to /" + id_ + "/mission_command").c_str());
+    get_logger(), "[ %s ] subscribed to /%s/mission_command", id_.c_str(), id_.c_str());
 
   poll_pub_ = create_publisher<bf_msgs::msg::Mission>(
     "/mission_poll", 100);
@@ -100,15 +102,15 @@ RemoteDelegateActionNode::control_cycle()
   if ((!working_) && (elapsed.seconds() > waiting_time_) && (waiting_time_ > 0.0)) {
     n_tries_ = 0;
     waiting_time_ = 0.0;
-    RCLCPP_DEBUG(get_logger(), ("[ " + id_ + " ] " + "waiting time elapsed").c_str());
+    RCLCPP_DEBUG(get_logger(), "[ %s ] waiting time elapsed", id_.c_str());
   }
 
   if (working_) {
     // if nobody is waiting for the mission status, do not publish it and stop working
     if (status_pub_->get_subscription_count() == 0) {
-      RCLCPP_INFO(
-        get_logger(),
-        ("[ " + id_ + " ] " + "nobody is waiting for the status, STOPPING tree (?)").c_str());
+      RCLCPP_INFO_THROTTLE(
+        get_logger(), *get_clock(), 5000,
+        "[ %s ] nobody is waiting for the status, STOPPING tree (?)", id_.c_str());
       // working_ = false;
       // bb_handler_.reset();
       // return;
@@ -116,21 +118,28 @@ RemoteDelegateActionNode::control_cycle()
 
 
     BT::NodeStatus status = tree_.rootNode()->executeTick();
+    // the tree writes its output ports straight to the blackboard
+    for (const auto & key : output_keys_) {
+      bb_handler_->notify_write(key);
+    }
+    if (scan_after_tick_) {
+      bb_handler_->request_scan();
+    }
 
     // spin bb_handler_ activate the callbacks to keep the shared blackboard updated
     rclcpp::spin_some(bb_handler_);
-    RCLCPP_DEBUG(get_logger(), "blackboard handler spinned");
+    BF_TRACE(get_logger(), "blackboard handler spinned");
 
     auto start_time = std::chrono::high_resolution_clock::now();
     auto end_time = start_time + std::chrono::seconds(5);
     switch (status) {
       case BT::NodeStatus::RUNNING:
         status_msg.status = bf_msgs::msg::Mission::RUNNING;
-        RCLCPP_DEBUG(get_logger(), ("[ " + id_ + " ] " + "RUNNING").c_str());
+        BF_TRACE(get_logger(), "[ %s ] RUNNING", id_.c_str());
         break;
       case BT::NodeStatus::SUCCESS:
         status_msg.status = bf_msgs::msg::Mission::SUCCESS;
-        RCLCPP_INFO(get_logger(), ("[ " + id_ + " ] " + "***** SUCCESS *****").c_str());
+        RCLCPP_INFO(get_logger(), "[ %s ] ***** SUCCESS *****", id_.c_str());
 
         // IMPROVE THIS
         // the bb_handler needs to be spinned for a while in case there are pending updates to the global bb
@@ -147,7 +156,7 @@ RemoteDelegateActionNode::control_cycle()
         break;
       case BT::NodeStatus::FAILURE:
         status_msg.status = bf_msgs::msg::Mission::FAILURE;
-        RCLCPP_INFO(get_logger(), ("[ " + id_ + " ] " + "FAILURE").c_str());
+        RCLCPP_INFO(get_logger(), "[ %s ] FAILURE", id_.c_str());
         while (std::chrono::high_resolution_clock::now() < end_time) {
           rclcpp::spin_some(bb_handler_);
         }
@@ -160,7 +169,7 @@ RemoteDelegateActionNode::control_cycle()
   } else {
     if (bb_handler_.get() != nullptr) {
       bb_handler_.reset();
-      RCLCPP_DEBUG(get_logger(), ("[ " + id_ + " ] " + "bb_handler reset").c_str());
+      RCLCPP_DEBUG(get_logger(), "[ %s ] bb_handler reset", id_.c_str());
     }
     status_msg.status = bf_msgs::msg::Mission::IDLE;
   }
@@ -178,7 +187,7 @@ RemoteDelegateActionNode::create_tree()
   if (plugins.size() == 0) {
     load_plugins = false;
     // plugins = this->get_parameter("plugins").as_string_array();
-    RCLCPP_INFO(get_logger(), ("[ " + id_ + " ] " + "plugins not in the mission command").c_str());
+    RCLCPP_INFO(get_logger(), "[ %s ] plugins not in the mission command", id_.c_str());
     // if (plugins[0] == "none") {
     //   RCLCPP_INFO(get_logger(), ("[ " + id_ + " ] " + "no plugins to load").c_str());
     //   load_plugins = false;
@@ -213,6 +222,7 @@ RemoteDelegateActionNode::create_tree()
     }
 
     tree_ = factory.createTreeFromText(mission_->mission_tree, blackboard);
+    watch_tree(blackboard);
     RCLCPP_INFO(get_logger(), "MISSION TREE created. Robot WORKING...");
 
     return true;
@@ -223,11 +233,46 @@ RemoteDelegateActionNode::create_tree()
     status_msg.status = bf_msgs::msg::Mission::IDLE;
     status_msg.source_id = mission_->source_id;
     status_pub_->publish(status_msg);
-    RCLCPP_ERROR(get_logger(), ("[ " + id_ + " ] " + "ERROR creating tree: " + e.what()).c_str());
+    RCLCPP_ERROR(get_logger(), "[ %s ] ERROR creating tree: %s", id_.c_str(), e.what());
     return false;
   }
 }
 
+void
+RemoteDelegateActionNode::watch_tree(const BT::Blackboard::Ptr & blackboard)
+{
+  std::set<std::string> keys;
+  scan_after_tick_ = false;
+
+  std::function<void(BT::TreeNode *)> visitor = [&](BT::TreeNode * node) {
+      const auto & config = node->config();
+      const auto & type = node->registrationName();
+      // scripts and subtrees write keys that are not in the output ports of the tree
+      if (config.blackboard != blackboard || !config.pre_conditions.empty() ||
+        !config.post_conditions.empty() || type == "Script" || type == "ScriptCondition" ||
+        type == "SetBlackboard" || type == "UnsetBlackboard")
+      {
+        scan_after_tick_ = true;
+        return;
+      }
+      for (const auto & [port, value] : config.output_ports) {
+        BT::StringView key;
+        if (BT::TreeNode::isBlackboardPointer(value, &key)) {
+          if (!key.empty() && key.front() == '@') {
+            key.remove_prefix(1);  // {@key}: the root blackboard, that is this one
+          }
+          keys.insert(key == "=" ? port : std::string(key));
+        }
+      }
+    };
+  tree_.applyVisitor(visitor);
+
+  output_keys_.assign(keys.begin(), keys.end());
+  RCLCPP_DEBUG(
+    get_logger(), "[ %s ] %zu output keys, %s", id_.c_str(), output_keys_.size(),
+    scan_after_tick_ ? "scan after every tick" : "no scan");
+}
+
 void
 RemoteDelegateActionNode::mission_poll_callback(bf_msgs::msg::Mission::UniquePtr msg)
 {
@@ -244,11 +289,9 @@ RemoteDelegateActionNode::mission_poll_callback(bf_msgs::msg::Mission::UniquePtr
     mission_ = std::move(msg);
 
     if (((mission_->robot_id).length() > 0) && ((mission_->robot_id).compare(id_) != 0)) {
-      RCLCPP_INFO(
-        get_logger(),
-        ("[ " + id_ + " ] " + "MISSION ignored (code " +
-        std::to_string(bf_msgs::msg::Mission::OFFER) + "): I'm not " +
-        mission_->robot_id).c_str());
+      BF_TRACE(
+        get_logger(), "[ %s ] MISSION ignored (code %d): I'm not %s", id_.c_str(),
+        bf_msgs::msg::Mission::OFFER, mission_->robot_id.c_str());
       return;
     }
 
@@ -265,9 +308,8 @@ RemoteDelegateActionNode::mission_poll_callback(bf_msgs::msg::Mission::UniquePtr
       n_tries_++;
       t_last_request_ = rclcpp::Clock().now();
       RCLCPP_INFO(
-        get_logger(),
-        ("[ " + id_ + " ] " + "REQUEST sent (" + std::to_string(n_tries_) +
-        ") to " + mission_->source_id + ": " + mission_id_).c_str());
+        get_logger(), "[ %s ] REQUEST sent (%d) to %s: %s", id_.c_str(), n_tries_,
+        mission_->source_id.c_str(), mission_id_.c_str());
     } else {  // either the mission is not for the node or the node is silent for a while
       if ((n_tries_ >= (MAX_REQUEST_TRIES_ - 1)) && (waiting_time_ == 0)) {
         // wait a random time (maximum MAX_WAITING_TIME_) before trying again
@@ -276,31 +318,29 @@ RemoteDelegateActionNode::mission_poll_callback(bf_msgs::msg::Mission::UniquePtr
         std::uniform_real_distribution<> dis(0.5, MAX_WAITING_TIME_);
         waiting_time_ = dis(gen);
         RCLCPP_DEBUG(
-          get_logger(), ("[ " + id_ + " ] " + "WAITING " + std::to_string(waiting_time_) +
-          " seconds before trying again").c_str());
+          get_logger(), "[ %s ] WAITING %f seconds before trying again", id_.c_str(),
+          waiting_time_);
       }
-      RCLCPP_DEBUG(get_logger(), ("[ " + id_ + " ] " + "unable to execute MISSION").c_str());
+      BF_TRACE(get_logger(), "[ %s ] unable to execute MISSION", id_.c_str());
     }
   } else {
-    RCLCPP_DEBUG(get_logger(), ("[ " + id_ + " ] " + "OFFER ignored, I'm BUSY").c_str());
+    BF_TRACE(get_logger(), "[ %s ] OFFER ignored, I'm BUSY", id_.c_str());
   }
 }
 
 void
 RemoteDelegateActionNode::mission_callback(bf_msgs::msg::Mission::UniquePtr msg)
 {
-  RCLCPP_DEBUG(get_logger(), ("[ " + id_ + " ] " + "mission callback").c_str());
+  BF_TRACE(get_logger(), "[ %s ] mission callback", id_.c_str());
   if ((msg->msg_type != bf_msgs::msg::Mission::COMMAND) &&
     msg->msg_type != bf_msgs::msg::Mission::HALT)
   {
-    RCLCPP_INFO(
-      get_logger(),
-      ("[ " + id_ + " ] " + "Wrong message type received").c_str());
+    RCLCPP_INFO(get_logger(), "[ %s ] Wrong message type received", id_.c_str());
     return;
   }
 
   if (msg->msg_type == bf_msgs::msg::Mission::HALT) {
-    RCLCPP_INFO(get_logger(), ("[ " + id_ + " ] " + "HALT signal received").c_str());
+    RCLCPP_INFO(get_logger(), "[ %s ] HALT signal received", id_.c_str());
     bf_msgs::msg::Mission status_msg;
     status_msg.msg_type = bf_msgs::msg::Mission::STATUS;
     status_msg.robot_id = id_;
@@ -314,21 +354,20 @@ RemoteDelegateActionNode::mission_callback(bf_msgs::msg::Mission::UniquePtr msg)
   // ignore missions if already working
   if (!working_) {
     RCLCPP_INFO(
-      get_logger(), ("[ " + id_ + " ] " + "MISSION received (" + msg->source_id + ")").c_str());
+      get_logger(), "[ %s ] MISSION received (%s)", id_.c_str(), msg->source_id.c_str());
     mission_ = std::move(msg);
     if (mission_->robot_id == id_) {
-      RCLCPP_DEBUG(
-        get_logger(), ("[ " + id_ + " ]\n" + mission_->mission_tree).c_str());
+      RCLCPP_DEBUG(get_logger(), "[ %s ]\n%s", id_.c_str(), mission_->mission_tree.c_str());
       working_ = create_tree();
     } else {
       RCLCPP_DEBUG(
-        get_logger(),
-        ("[ " + id_ + " ] " + "MISSION ignored (" + msg->source_id + "), not for me").c_str());
+        get_logger(), "[ %s ] MISSION ignored (%s), not for me", id_.c_str(),
+        mission_->source_id.c_str());
     }
   } else {
-    RCLCPP_DEBUG(
-      get_logger(),
-      ("[ " + id_ + " ] " + "MISSION ignored (" + msg->source_id + "), I'm BUSY").c_str());
+    BF_TRACE(
+      get_logger(), "[ %s ] MISSION ignored (%s), I'm BUSY", id_.c_str(),
+      msg->source_id.c_str());
   }
 }
 
@@ -0,0 +1,92 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "behaviorfleets/ShardMap.hpp"
+
+namespace BF
+{
+
+ShardMap::ShardMap(int shards, const std::vector<std::string> & prefix_rules)
+: shards_(std::max(shards, 1))
+{
+  // malformed rules and rules pointing to a missing shard are ignored
+  for (const auto & rule : prefix_rules) {
+    size_t sep = rule.rfind('=');
+    if (sep == std::string::npos || sep == 0) {
+      continue;
+    }
+    int shard = -1;
+    const char * first = rule.data() + sep + 1;
+    const char * last = rule.data() + rule.size();
+    auto result = std::from_chars(first, last, shard);
+    if (result.ec != std::errc() || result.ptr != last || shard < 0 || shard >= shards_) {
+      continue;
+    }
+    prefixes_.emplace_back(rule.substr(0, sep), shard);
+  }
+
+  std::sort(
+    prefixes_.begin(), prefixes_.end(),
+    [](const auto & a, const auto & b) {return a.first.size() > b.first.size();});
+}
+
+int ShardMap::shard(const std::string & key) const
+{
+  if (shards_ == 1) {
+    return 0;
+  }
+
+  for (const auto & prefix : prefixes_) {
+    if (key.compare(0, prefix.first.size(), prefix.first) == 0) {
+      return prefix.second;
+    }
+  }
+
+  // FNV-1a, so that every host maps a key to the same shard
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<int>(hash % shards_);
+}
+
+std::string ShardMap::topic(int shard) const
+{
+  if (shards_ == 1) {
+    return "/blackboard";
+  }
+  return "/blackboard/shard_" + std::to_string(shard);
+}
+
+bool ShardMap::valid_robot_id(const std::string & robot_id)
+{
+  if (robot_id.empty() || (robot_id[0] >= '0' && robot_id[0] <= '9')) {
+    return false;
+  }
+  return std::all_of(
+    robot_id.begin(), robot_id.end(),
+    [](char c) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+             c == '_';
+    });
+}
+
+}  // namespace BF
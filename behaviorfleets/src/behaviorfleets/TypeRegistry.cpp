@@ -0,0 +1,297 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "behaviorfleets/TypeRegistry.hpp"
+
+namespace BF
+{
+
+using bf_msgs::msg::BlackboardEntry;
+
+namespace
+{
+
+template<typename T>
+void read_value(const BT::Any & value, BlackboardEntry * entry)
+{
+  if constexpr (std::is_same_v<T, bool>) {
+    entry->bool_value = value.cast<bool>();
+  } else if constexpr (std::is_integral_v<T>) {
+    entry->int_value = static_cast<int64_t>(value.cast<T>());
+  } else if constexpr (std::is_floating_point_v<T>) {
+    entry->double_value = value.cast<T>();
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    entry->string_value = value.cast<std::string>();
+  } else if constexpr (std::is_same_v<T, OpaqueValue>) {
+    const auto & opaque = value.cast<OpaqueValue>();
+    entry->type_name = opaque.type_name;
+    entry->bytes_value = opaque.bytes;
+  } else {
+    entry->bytes_value = value.cast<std::vector<uint8_t>>();
+  }
+}
+
+template<typename T>
+bool write_value(const BlackboardEntry & entry, const BT::Blackboard::Ptr & bb)
+{
+  if constexpr (std::is_same_v<T, bool>) {
+    bb->set(entry.key, static_cast<bool>(entry.bool_value));
+  } else if constexpr (std::is_integral_v<T>) {
+    bb->set(entry.key, static_cast<T>(entry.int_value));
+  } else if constexpr (std::is_floating_point_v<T>) {
+    bb->set(entry.key, static_cast<T>(entry.double_value));
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    bb->set(entry.key, entry.string_value);
+  } else if constexpr (std::is_same_v<T, OpaqueValue>) {
+    bb->set(entry.key, OpaqueValue{entry.type_name, entry.bytes_value});
+  } else {
+    bb->set(entry.key, entry.bytes_value);
+  }
+  return true;
+}
+
+// type of the value stored under key, or the declared port type if it is still empty
+std::type_index stored_type(const BT::Blackboard::Ptr & bb, const std::string & key)
+{
+  const BT::Any * value = bb->getAny(key);
+  if (value != nullptr && !value->empty()) {
+    return value->type();
+  }
+  const BT::PortInfo * info = bb->portInfo(key);
+  if (info != nullptr) {
+    return info->type();
+  }
+  return typeid(void);
+}
+
+// FNV-1a hash of data, chained from hash
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t hash_bytes(uint64_t hash, const void * data, size_t size)
+{
+  auto bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+}  // namespace
+
+TypeRegistry & TypeRegistry::instance()
+{
+  static TypeRegistry registry;
+  return registry;
+}
+
+TypeRegistry::TypeRegistry()
+{
+  add<int>(BlackboardEntry::INT, true);
+  add<unsigned int>(BlackboardEntry::INT);
+  add<long>(BlackboardEntry::INT);  // NOLINT(runtime/int)
+  add<unsigned long>(BlackboardEntry::INT);  // NOLINT(runtime/int)
+  add<long long>(BlackboardEntry::INT);  // NOLINT(runtime/int)
+  add<unsigned long long>(BlackboardEntry::INT);  // NOLINT(runtime/int)
+  add<short>(BlackboardEntry::INT);  // NOLINT(runtime/int)
+  add<unsigned short>(BlackboardEntry::INT);  // NOLINT(runtime/int)
+  add<int8_t>(BlackboardEntry::INT);
+  add<uint8_t>(BlackboardEntry::INT);
+  add<float>(BlackboardEntry::FLOAT, true);
+  add<double>(BlackboardEntry::DOUBLE, true);
+  add<bool>(BlackboardEntry::BOOL, true);
+  add<std::string>(BlackboardEntry::STRING, true);
+  add<std::vector<uint8_t>>(BlackboardEntry::BYTES, true);
+  add<OpaqueValue>(BlackboardEntry::CUSTOM, true);
+}
+
+template<typename T>
+void TypeRegistry::add(uint8_t tag, bool default_for_tag)
+{
+  Visitor visitor{tag, "", &read_value<T>, &write_value<T>};
+  visitors_[typeid(T)] = visitor;
+  tags_[typeid(T)] = tag;
+  if (default_for_tag) {
+    defaults_[tag] = visitor;
+  }
+}
+
+void TypeRegistry::add_custom(const std::type_index & type, Visitor visitor)
+{
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  customs_.erase(visitor.type_name);
+  customs_.emplace(visitor.type_name, type);
+  tags_[type] = visitor.tag;  // may have been cached as unsupported
+  visitors_[type] = std::move(visitor);
+}
+
+// visitors are returned by copy: add_custom() may rehash visitors_ once the lock is released
+std::optional<TypeRegistry::Visitor> TypeRegistry::find_custom(const std::string & type_name)
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto type = customs_.find(type_name);
+  if (type == customs_.end()) {
+    return std::nullopt;
+  }
+  auto it = visitors_.find(type->second);
+  if (it == visitors_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+std::optional<TypeRegistry::Visitor> TypeRegistry::find(const std::type_index & type)
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = visitors_.find(type);
+  if (it == visitors_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+uint8_t TypeRegistry::tag(const std::type_index & type)
+{
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = tags_.find(type);
+    if (it != tags_.end()) {
+      return it->second;
+    }
+  }
+
+  // first time this type is seen: ports that accept any type hold text
+  uint8_t tag = UNSUPPORTED;
+  if (type == typeid(BT::Any) || type == typeid(BT::AnyTypeAllowed)) {
+    tag = BlackboardEntry::STRING;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  tags_[type] = tag;
+  return tag;
+}
+
+uint8_t TypeRegistry::tag(const BT::Blackboard::Ptr & bb, const std::string & key)
+{
+  return tag(stored_type(bb, key));
+}
+
+bool TypeRegistry::encode(
+  const BT::Blackboard::Ptr & bb, const std::string & key,
+  BlackboardEntry * entry)
+{
+  const BT::Any * value = bb->getAny(key);
+  if (value == nullptr || value->empty()) {
+    return false;
+  }
+
+  std::optional<Visitor> visitor = find(value->type());
+  if (!visitor) {
+    return false;
+  }
+
+  entry->key = key;
+  entry->type = visitor->tag;
+  visitor->read(*value, entry);
+  return true;
+}
+
+bool TypeRegistry::decode(const BlackboardEntry & entry, const BT::Blackboard::Ptr & bb)
+{
+  std::type_index type = stored_type(bb, entry.key);
+  std::optional<Visitor> visitor;
+
+  if (type != typeid(void)) {
+    visitor = find(type);
+    if (visitor &&
+      (visitor->tag != entry.type || visitor->type_name != entry.type_name))
+    {
+      // the key already holds an incompatible type; an opaque value takes any CUSTOM one
+      if (type != typeid(OpaqueValue) || entry.type != BlackboardEntry::CUSTOM) {
+        return false;
+      }
+    }
+    if (!visitor && tag(type) == UNSUPPORTED) {
+      return false;
+    }
+  }
+
+  if (!visitor && entry.type == BlackboardEntry::CUSTOM) {
+    visitor = find_custom(entry.type_name);  // else kept opaque
+  }
+  if (!visitor) {
+    // new key, or a port that accepts any type
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = defaults_.find(entry.type);
+    if (it == defaults_.end()) {
+      return false;
+    }
+    visitor = it->second;
+  }
+
+  return visitor->write(entry, bb);
+}
+
+bool same_value(const BlackboardEntry & a, const BlackboardEntry & b)
+{
+  if (a.type != b.type) {
+    return false;
+  }
+
+  switch (a.type) {
+    case BlackboardEntry::INT:
+      return a.int_value == b.int_value;
+    case BlackboardEntry::FLOAT:
+    case BlackboardEntry::DOUBLE:
+      return a.double_value == b.double_value;
+    case BlackboardEntry::BOOL:
+      return a.bool_value == b.bool_value;
+    case BlackboardEntry::STRING:
+      return a.string_value == b.string_value;
+    case BlackboardEntry::BYTES:
+      return a.bytes_value == b.bytes_value;
+    case BlackboardEntry::CUSTOM:
+      return a.type_name == b.type_name && a.bytes_value == b.bytes_value;
+  }
+  return false;
+}
+
+uint64_t fingerprint(const BlackboardEntry & entry)
+{
+  uint64_t hash = hash_bytes(FNV_OFFSET, &entry.type, sizeof(entry.type));
+  switch (entry.type) {
+    case BlackboardEntry::INT:
+      return hash_bytes(hash, &entry.int_value, sizeof(entry.int_value));
+    case BlackboardEntry::FLOAT:
+    case BlackboardEntry::DOUBLE:
+      return hash_bytes(hash, &entry.double_value, sizeof(entry.double_value));
+    case BlackboardEntry::BOOL:
+      return hash_bytes(hash, &entry.bool_value, sizeof(entry.bool_value));
+    case BlackboardEntry::STRING:
+      return hash_bytes(hash, entry.string_value.data(), entry.string_value.size());
+    case BlackboardEntry::CUSTOM:
+      hash = hash_bytes(hash, entry.type_name.data(), entry.type_name.size() + 1);
+      return hash_bytes(hash, entry.bytes_value.data(), entry.bytes_value.size());
+    case BlackboardEntry::BYTES:
+      return hash_bytes(hash, entry.bytes_value.data(), entry.bytes_value.size());
+  }
+  return hash;
+}
+
+}  // namespace BF
@@ -48,7 +48,7 @@ BlackboardStresser::BlackboardStresser(
 
   for (int i = 0; i < n_keys; i++) {
     keys_.push_back("key_" + std::to_string(i));
-    blackboard_->set(keys_[i], i);
+    bb_handler_->set(keys_[i], i);
   }
 
   RCLCPP_INFO(
@@ -128,8 +128,8 @@ void BlackboardStresser::update_blackboard()
 {
   int i = random_int(0, keys_.size() - 1);
   int val = random_int(0, 100);
-  RCLCPP_INFO(get_logger(), "updating key: %s to %d", keys_[i].c_str(), val);
-  blackboard_->set(keys_[i], val);
+  BF_TRACE(get_logger(), "updating key: %s to %d", keys_[i].c_str(), val);
+  bb_handler_->set(keys_[i], val);
 }
 
 int BlackboardStresser::random_int(int min, int max)
@@ -12,7 +12,7 @@ for file_path in os.listdir(path):
   with open(path + '/' + file_path) as f:
     if ('~' in f.name or 'xlsx' in f.name):
         continue
-    if (not('_handler' in file_path) and not('waiting_times' in file_path) and not('experiments' in file_path)):
+    if (not('_handler' in file_path) and not('waiting_times' in file_path) and not('hold_times' in file_path) and not('experiments' in file_path)):
       lines = f.readlines()
       d = {}
       for line in lines:
@@ -33,27 +33,21 @@ wts = []
 succ = []
 reqs = []
 upds = []
+gwts = []
 
 for file_path in os.listdir(path):
   with open(path + '/' + file_path) as f:
     if 'handler' in file_path:
-      lines = f.readlines()
       d = {}
-      i = 0
-      for line in lines:
+      for line in f.readlines():
         pairs = (line.rstrip('\n')).split(':')
-        if i == 0:
-          wts.append(pairs[1])
-          i += 1
-        elif i == 1:
-          reqs.append(pairs[1])
-          i += 1
-        elif i == 2:
-          succ.append(pairs[1])
-          i += 1
-        else:
-          upds.append(pairs[1])
-          i = 0
+        d[pairs[0]] = pairs[1]
+      wts.append(d['avg_wt'])
+      reqs.append(d['requests'])
+      succ.append(d['success'])
+      upds.append(d['updates'])
+      if 'avg_grant_wt' in d:
+        gwts.append(d['avg_grant_wt'])
   
 
 upds = [int(x) for x in upds]
@@ -62,6 +56,8 @@ reqs = [int(x) for x in reqs]
 wts = [float(x) for x in wts]
 wts = [x for x in wts if not math.isnan(x)]
 wts = [x / 1e3 for x in wts] 
+gwts = [float(x) for x in gwts]
+gwts = [x / 1e3 for x in gwts if not math.isnan(x)]
 
 zero_indices = [i for i, v in enumerate(reqs) if v == 0]
 succ_aux = succ.copy()
@@ -87,6 +83,11 @@ print('max wt', end=" = ")
 print(max(wts))
 print('min wt', end=" = ")
 print(min(wts))
+if gwts:
+  print('avg grant wt', end=" = ")
+  print(np.mean(gwts))
+  print('max grant wt', end=" = ")
+  print(max(gwts))
 print('-' * 10)
 print('avg reqs', end=" = ")
 print(np.mean(reqs))
@@ -129,15 +130,14 @@ path = path + '/waiting_times.txt'
 wts = []
 
 with open(path) as f:
-  lines = f.readlines()
-  for line in lines:
-    line = line.rstrip('\n')
-    wts.append(float(line))
+  lines = [line.rstrip('\n') for line in f.readlines()]
 
-n_releases = int(wts[-1])
-max_q = int(wts[-2])
-wts.pop()
-wts = [float(x) for x in wts]
+# histogram buckets (wait:count) followed by the maximum queue size and the number of pubs
+n_releases = int(lines[-1])
+max_q = int(lines[-2])
+for line in lines[:-2]:
+  wait, count = line.split(':')
+  wts.extend([float(wait)] * int(count))
 wts = [x for x in wts if not math.isnan(x)]
 wts = [x / 1e3 for x in wts] 
 
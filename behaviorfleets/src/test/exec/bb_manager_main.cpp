@@ -55,7 +55,11 @@ int main(int argc, char * argv[])
     auto bb_manager = std::make_shared<BF::BlackboardManager>(blackboard, period, 1000);
     // auto bb_manager = std::make_shared<BF::BlackboardManager>(blackboard);
 
-    rclcpp::spin(bb_manager);
+    // the manager takes the requests on one thread (its ingest group) and its timers on
+    // another; it applies the requests on its own commit thread
+    rclcpp::executors::MultiThreadedExecutor executor;
+    executor.add_node(bb_manager);
+    executor.spin();
 
     std::cout << "Finished" << std::endl;
     rclcpp::shutdown();
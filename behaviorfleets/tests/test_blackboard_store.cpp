@@ -0,0 +1,208 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "behaviorfleets/BlackboardStore.hpp"
+
+namespace
+{
+
+bf_msgs::msg::Blackboard record(const std::string & key, int64_t value, uint64_t version)
+{
+  bf_msgs::msg::BlackboardEntry entry;
+  entry.key = key;
+  entry.type = bf_msgs::msg::BlackboardEntry::INT;
+  entry.int_value = value;
+  entry.version = version;
+
+  bf_msgs::msg::Blackboard msg;
+  msg.type = bf_msgs::msg::Blackboard::PUBLISH;
+  msg.entries.push_back(entry);
+  return msg;
+}
+
+std::vector<bf_msgs::msg::Blackboard> recover(const std::string & dir)
+{
+  BF::BlackboardStore store;
+  std::vector<bf_msgs::msg::Blackboard> records;
+  EXPECT_TRUE(store.open(dir));
+  store.recover(
+    [&records](const bf_msgs::msg::Blackboard & record) {
+      records.push_back(record);
+    });
+  return records;
+}
+
+class BlackboardStoreTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    dir_ = (std::filesystem::temp_directory_path() /
+      ("bf_store_" + std::to_string(::getpid()) + "_" +
+      ::testing::UnitTest::GetInstance()->current_test_info()->name())).string();
+    std::filesystem::remove_all(dir_);
+  }
+
+  void TearDown() override
+  {
+    std::filesystem::remove_all(dir_);
+  }
+
+  std::string wal() const {return dir_ + "/blackboard.wal";}
+
+  std::string dir_;
+};
+
+}  // namespace
+
+TEST_F(BlackboardStoreTest, ClosedStoreRejectsWrites)
+{
+  BF::BlackboardStore store;
+
+  EXPECT_FALSE(store.is_open());
+  EXPECT_FALSE(store.append(record("a", 1, 1)));
+  EXPECT_FALSE(store.checkpoint(record("a", 1, 1)));
+}
+
+TEST_F(BlackboardStoreTest, RecoversTheLogInOrder)
+{
+  {
+    BF::BlackboardStore store;
+    ASSERT_TRUE(store.open(dir_));
+    ASSERT_TRUE(store.append(record("a", 1, 1)));
+    ASSERT_TRUE(store.append(record("b", 2, 2)));
+    ASSERT_TRUE(store.append(record("a", 3, 3)));
+  }
+
+  auto records = recover(dir_);
+  ASSERT_EQ(records.size(), 3u);
+  EXPECT_EQ(records[0].entries[0].key, "a");
+  EXPECT_EQ(records[0].entries[0].int_value, 1);
+  EXPECT_EQ(records[1].entries[0].key, "b");
+  EXPECT_EQ(records[2].entries[0].int_value, 3);
+  EXPECT_EQ(records[2].entries[0].version, 3u);
+}
+
+TEST_F(BlackboardStoreTest, AppendsAfterReopening)
+{
+  {
+    BF::BlackboardStore store;
+    ASSERT_TRUE(store.open(dir_, false));
+    ASSERT_TRUE(store.append(record("a", 1, 1)));
+  }
+  {
+    BF::BlackboardStore store;
+    ASSERT_TRUE(store.open(dir_, false));
+    ASSERT_TRUE(store.append(record("a", 2, 2)));
+  }
+
+  auto records = recover(dir_);
+  ASSERT_EQ(records.size(), 2u);
+  EXPECT_EQ(records[1].entries[0].int_value, 2);
+}
+
+TEST_F(BlackboardStoreTest, CheckpointReplacesTheLog)
+{
+  {
+    BF::BlackboardStore store;
+    ASSERT_TRUE(store.open(dir_));
+    ASSERT_TRUE(store.append(record("a", 1, 1)));
+    ASSERT_TRUE(store.append(record("a", 2, 2)));
+
+    auto snapshot = record("a", 2, 2);
+    snapshot.full_snapshot = true;
+    ASSERT_TRUE(store.checkpoint(snapshot));
+    EXPECT_EQ(std::filesystem::file_size(wal()), 0u);
+    EXPECT_FALSE(std::filesystem::exists(dir_ + "/blackboard.ckpt.tmp"));
+
+    ASSERT_TRUE(store.append(record("b", 5, 3)));
+  }
+
+  auto records = recover(dir_);
+  ASSERT_EQ(records.size(), 2u);
+  EXPECT_TRUE(records[0].full_snapshot);
+  EXPECT_EQ(records[0].entries[0].int_value, 2);
+  EXPECT_EQ(records[1].entries[0].key, "b");
+}
+
+TEST_F(BlackboardStoreTest, TornTailIsDropped)
+{
+  {
+    BF::BlackboardStore store;
+    ASSERT_TRUE(store.open(dir_));
+    ASSERT_TRUE(store.append(record("a", 1, 1)));
+    ASSERT_TRUE(store.append(record("b", 2, 2)));
+  }
+  // a crash in the middle of the last write
+  std::filesystem::resize_file(wal(), std::filesystem::file_size(wal()) - 3);
+
+  auto records = recover(dir_);
+  ASSERT_EQ(records.size(), 1u);
+  EXPECT_EQ(records[0].entries[0].key, "a");
+}
+
+TEST_F(BlackboardStoreTest, TornHeaderIsDropped)
+{
+  {
+    BF::BlackboardStore store;
+    ASSERT_TRUE(store.open(dir_));
+    ASSERT_TRUE(store.append(record("a", 1, 1)));
+  }
+  size_t size = std::filesystem::file_size(wal());
+  {
+    std::ofstream file(wal(), std::ios::binary | std::ios::app);
+    file.write("\x10\x00", 2);
+  }
+  ASSERT_EQ(std::filesystem::file_size(wal()), size + 2);
+
+  EXPECT_EQ(recover(dir_).size(), 1u);
+}
+
+TEST_F(BlackboardStoreTest, ReplayStopsAtACorruptedRecord)
+{
+  size_t first_size;
+  {
+    BF::BlackboardStore store;
+    ASSERT_TRUE(store.open(dir_));
+    ASSERT_TRUE(store.append(record("a", 1, 1)));
+    first_size = std::filesystem::file_size(wal());
+    ASSERT_TRUE(store.append(record("b", 2, 2)));
+    ASSERT_TRUE(store.append(record("c", 3, 3)));
+  }
+
+  // flip the last byte of the second record: its length is intact, its CRC is not
+  {
+    std::fstream file(wal(), std::ios::binary | std::ios::in | std::ios::out);
+    size_t offset = 2 * first_size - 1;
+    file.seekg(offset);
+    char byte;
+    file.read(&byte, 1);
+    byte ^= 0x5a;
+    file.seekp(offset);
+    file.write(&byte, 1);
+  }
+
+  auto records = recover(dir_);
+  ASSERT_EQ(records.size(), 1u);
+  EXPECT_EQ(records[0].entries[0].key, "a");
+}
@@ -0,0 +1,208 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "behaviorfleets/GrantScheduler.hpp"
+
+namespace
+{
+
+BF::GrantScheduler::Request request(
+  const std::string & robot_id, uint8_t priority = 0, int64_t deadline_ns = 0,
+  const std::vector<std::string> & keys = {})
+{
+  BF::GrantScheduler::Request r;
+  r.robot_id = robot_id;
+  r.keys = keys;
+  r.priority = priority;
+  r.deadline = rclcpp::Time(deadline_ns);
+  return r;
+}
+
+std::vector<std::string> order(const BF::GrantScheduler & scheduler)
+{
+  std::vector<std::string> ids;
+  for (const auto & r : scheduler.ordered()) {
+    ids.push_back(r.robot_id);
+  }
+  return ids;
+}
+
+// grants the head of the queue, as the manager does once the blackboard is free
+std::string grant(BF::GrantScheduler & scheduler)
+{
+  std::string robot_id = scheduler.ordered().begin()->robot_id;
+  scheduler.pop(robot_id);
+  return robot_id;
+}
+
+}  // namespace
+
+TEST(GrantScheduler, WeightRules)
+{
+  BF::GrantScheduler scheduler({"r1=2", "r2=0.5", "bad", "=3", "r3=0", "r4=-1", "r5=x"});
+
+  EXPECT_EQ(scheduler.n_weights(), 2u);
+  EXPECT_DOUBLE_EQ(scheduler.weight("r1"), 2.0);
+  EXPECT_DOUBLE_EQ(scheduler.weight("r2"), 0.5);
+  EXPECT_DOUBLE_EQ(scheduler.weight("r3"), 1.0);
+  EXPECT_DOUBLE_EQ(scheduler.weight("unknown"), 1.0);
+}
+
+TEST(GrantScheduler, ArrivalOrder)
+{
+  BF::GrantScheduler scheduler;
+  scheduler.push(request("r1"));
+  scheduler.push(request("r2"));
+  scheduler.push(request("r3"));
+
+  EXPECT_EQ(order(scheduler), (std::vector<std::string>{"r1", "r2", "r3"}));
+}
+
+TEST(GrantScheduler, PriorityThenDeadline)
+{
+  BF::GrantScheduler scheduler;
+  scheduler.push(request("none"));
+  scheduler.push(request("late", 0, 2000));
+  scheduler.push(request("urgent", 3));
+  scheduler.push(request("early", 0, 1000));
+  scheduler.push(request("high", 1, 5000));
+
+  EXPECT_EQ(
+    order(scheduler),
+    (std::vector<std::string>{"urgent", "high", "early", "late", "none"}));
+}
+
+TEST(GrantScheduler, RepeatedRequestIsMerged)
+{
+  BF::GrantScheduler scheduler;
+  EXPECT_TRUE(scheduler.push(request("r1", 0, 3000, {"a", "b"})));
+  EXPECT_TRUE(scheduler.push(request("r2", 1)));
+  EXPECT_FALSE(scheduler.push(request("r1", 2, 1000, {"b", "c"})));
+
+  ASSERT_EQ(scheduler.size(), 2u);
+  const auto * r1 = scheduler.find("r1");
+  ASSERT_NE(r1, nullptr);
+  EXPECT_EQ(r1->robot_id, "r1");
+  EXPECT_EQ(r1->keys, (std::vector<std::string>{"a", "b", "c"}));
+  EXPECT_EQ(r1->priority, 2);
+  EXPECT_EQ(r1->deadline.nanoseconds(), 1000);
+  EXPECT_EQ(order(scheduler), (std::vector<std::string>{"r1", "r2"}));
+
+  // a later deadline does not postpone it, and an empty key list widens it to everything
+  EXPECT_FALSE(scheduler.push(request("r1", 0, 2000)));
+  r1 = scheduler.find("r1");
+  ASSERT_NE(r1, nullptr);
+  EXPECT_EQ(r1->deadline.nanoseconds(), 1000);
+  EXPECT_TRUE(r1->keys.empty());
+  EXPECT_EQ(r1->priority, 2);
+  EXPECT_EQ(scheduler.find("r3"), nullptr);
+}
+
+TEST(GrantScheduler, MergeKeepsThePlaceInTheQueue)
+{
+  BF::GrantScheduler scheduler;
+  scheduler.push(request("r1"));
+  scheduler.push(request("r2"));
+  scheduler.push(request("r3"));
+
+  // widening the keys of r1 does not send it to the back
+  EXPECT_FALSE(scheduler.push(request("r1", 0, 0, {"a"})));
+  EXPECT_EQ(order(scheduler), (std::vector<std::string>{"r1", "r2", "r3"}));
+
+  // a higher priority moves r3 ahead, and it stays indexed
+  EXPECT_FALSE(scheduler.push(request("r3", 1)));
+  EXPECT_EQ(order(scheduler), (std::vector<std::string>{"r3", "r1", "r2"}));
+  scheduler.pop("r3");
+  EXPECT_EQ(order(scheduler), (std::vector<std::string>{"r1", "r2"}));
+  EXPECT_EQ(scheduler.find("r3"), nullptr);
+}
+
+TEST(GrantScheduler, PopAndClear)
+{
+  BF::GrantScheduler scheduler;
+  scheduler.push(request("r1"));
+  scheduler.push(request("r2"));
+
+  scheduler.pop("unknown");
+  EXPECT_EQ(scheduler.size(), 2u);
+  scheduler.pop("r1");
+  EXPECT_EQ(order(scheduler), (std::vector<std::string>{"r2"}));
+  scheduler.clear();
+  EXPECT_TRUE(scheduler.empty());
+}
+
+TEST(GrantScheduler, WeightedFairShare)
+{
+  BF::GrantScheduler scheduler({"heavy=2"});
+  std::map<std::string, int> grants;
+
+  // both robots ask again as soon as they are granted
+  for (int i = 0; i < 30; i++) {
+    scheduler.push(request("heavy"));
+    scheduler.push(request("light"));
+    grants[grant(scheduler)]++;
+  }
+
+  EXPECT_EQ(grants["heavy"], 20);
+  EXPECT_EQ(grants["light"], 10);
+}
+
+TEST(GrantScheduler, EqualWeightsAlternate)
+{
+  BF::GrantScheduler scheduler;
+  std::vector<std::string> granted;
+
+  for (int i = 0; i < 6; i++) {
+    scheduler.push(request("r1"));
+    scheduler.push(request("r2"));
+    granted.push_back(grant(scheduler));
+  }
+
+  EXPECT_EQ(granted, (std::vector<std::string>{"r1", "r2", "r1", "r2", "r1", "r2"}));
+}
+
+TEST(GrantScheduler, IdleRobotKeepsNoCredit)
+{
+  BF::GrantScheduler scheduler;
+  for (int i = 0; i < 10; i++) {
+    scheduler.push(request("busy"));
+    grant(scheduler);
+  }
+
+  // a robot that was idle all along goes first, but then has to share
+  std::vector<std::string> granted;
+  for (int i = 0; i < 4; i++) {
+    scheduler.push(request("busy"));
+    scheduler.push(request("idle"));
+    granted.push_back(grant(scheduler));
+  }
+
+  EXPECT_EQ(granted, (std::vector<std::string>{"idle", "busy", "idle", "busy"}));
+}
+
+TEST(GrantScheduler, PriorityOverridesFairShare)
+{
+  BF::GrantScheduler scheduler;
+  for (int i = 0; i < 3; i++) {
+    scheduler.push(request("urgent", 1));
+    scheduler.push(request("normal"));
+    EXPECT_EQ(grant(scheduler), "urgent");
+  }
+}
@@ -0,0 +1,170 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "behaviorfleets/KeyFilter.hpp"
+#include "behaviorfleets/ShardMap.hpp"
+
+TEST(KeyFilter, NoRules)
+{
+  BF::KeyFilter filter;
+
+  EXPECT_TRUE(filter.empty());
+  EXPECT_FALSE(filter.matches(""));
+  EXPECT_FALSE(filter.matches("robot_pose"));
+}
+
+TEST(KeyFilter, EmptyRulesAreIgnored)
+{
+  BF::KeyFilter filter({"", "pose", ""});
+
+  EXPECT_EQ(filter.rules(), (std::vector<std::string>{"pose"}));
+  EXPECT_FALSE(filter.matches(""));
+}
+
+TEST(KeyFilter, ExactKeys)
+{
+  BF::KeyFilter filter({"pose", "goal"});
+
+  EXPECT_TRUE(filter.matches("pose"));
+  EXPECT_TRUE(filter.matches("goal"));
+  EXPECT_FALSE(filter.matches("pose2"));
+  EXPECT_FALSE(filter.matches("pos"));
+  EXPECT_FALSE(filter.matches("Pose"));
+}
+
+TEST(KeyFilter, Prefixes)
+{
+  BF::KeyFilter filter({"nav/*", "n*", "arm/joint_*"});
+
+  EXPECT_TRUE(filter.matches("nav/goal"));
+  EXPECT_TRUE(filter.matches("nav/"));
+  EXPECT_TRUE(filter.matches("n"));
+  EXPECT_TRUE(filter.matches("arm/joint_1"));
+  EXPECT_FALSE(filter.matches("arm/joint"));
+  EXPECT_FALSE(filter.matches("arm/gripper"));
+  EXPECT_FALSE(filter.matches("map"));
+}
+
+TEST(KeyFilter, Globs)
+{
+  BF::KeyFilter filter({"*efbb_*", "a?c", "x*y*z"});
+
+  EXPECT_TRUE(filter.matches("efbb_robot_id"));
+  EXPECT_TRUE(filter.matches("my_efbb_x"));
+  EXPECT_FALSE(filter.matches("efb_x"));
+
+  EXPECT_TRUE(filter.matches("abc"));
+  EXPECT_TRUE(filter.matches("a?c"));
+  EXPECT_FALSE(filter.matches("ac"));
+  EXPECT_FALSE(filter.matches("abbc"));
+
+  EXPECT_TRUE(filter.matches("xyz"));
+  EXPECT_TRUE(filter.matches("xaayzz"));
+  EXPECT_TRUE(filter.matches("xyzyz"));
+  EXPECT_FALSE(filter.matches("xzy"));
+  EXPECT_FALSE(filter.matches("xyzq"));
+}
+
+TEST(KeyFilter, MatchEverything)
+{
+  BF::KeyFilter filter({"*"});
+
+  EXPECT_TRUE(filter.matches(""));
+  EXPECT_TRUE(filter.matches("anything"));
+}
+
+TEST(ShardMap, SingleShard)
+{
+  BF::ShardMap map(1, {"nav/=0"});
+
+  EXPECT_EQ(map.shards(), 1);
+  EXPECT_EQ(map.shard("nav/goal"), 0);
+  EXPECT_EQ(map.shard("anything"), 0);
+  EXPECT_EQ(map.topic(0), "/blackboard");
+  EXPECT_EQ(map.requests_topic(0), "/blackboard/requests");
+  EXPECT_EQ(map.reply_topic(0, "r1"), "/blackboard/r1/reply");
+}
+
+TEST(ShardMap, NonPositiveShardsMeanOne)
+{
+  EXPECT_EQ(BF::ShardMap(0).shards(), 1);
+  EXPECT_EQ(BF::ShardMap(-3).shards(), 1);
+}
+
+TEST(ShardMap, Topics)
+{
+  BF::ShardMap map(3);
+
+  EXPECT_EQ(map.topic(2), "/blackboard/shard_2");
+  EXPECT_EQ(map.requests_topic(2), "/blackboard/shard_2/requests");
+  EXPECT_EQ(map.reply_topic(1, "r1"), "/blackboard/shard_1/r1/reply");
+  EXPECT_EQ(map.data_topic(0), "/blackboard/shard_0/data");
+  EXPECT_EQ(map.heartbeat_topic(0), "/blackboard/shard_0/heartbeat");
+  EXPECT_EQ(map.log_topic(0), "/blackboard/shard_0/log");
+  EXPECT_EQ(map.stats_topic(0), "/blackboard/shard_0/stats");
+}
+
+TEST(ShardMap, ValidRobotIds)
+{
+  EXPECT_TRUE(BF::ShardMap::valid_robot_id("r1"));
+  EXPECT_TRUE(BF::ShardMap::valid_robot_id("robot_2_bbh"));
+  EXPECT_TRUE(BF::ShardMap::valid_robot_id("_hidden"));
+
+  EXPECT_FALSE(BF::ShardMap::valid_robot_id(""));
+  EXPECT_FALSE(BF::ShardMap::valid_robot_id("1robot"));
+  EXPECT_FALSE(BF::ShardMap::valid_robot_id("r1/../r2"));
+  EXPECT_FALSE(BF::ShardMap::valid_robot_id("r 1"));
+  EXPECT_FALSE(BF::ShardMap::valid_robot_id("r-1"));
+  EXPECT_FALSE(BF::ShardMap::valid_robot_id("~r1"));
+}
+
+TEST(ShardMap, InvalidRulesAreIgnored)
+{
+  BF::ShardMap map(2, {"nav/=1", "arm/=2", "map/=-1", "=1", "pose", "goal=1x", "odom=0"});
+
+  EXPECT_EQ(map.n_rules(), 2u);
+}
+
+TEST(ShardMap, LongestPrefixWins)
+{
+  BF::ShardMap map(3, {"nav/=1", "nav/local/=2", "n=0"});
+
+  EXPECT_EQ(map.shard("nav/goal"), 1);
+  EXPECT_EQ(map.shard("nav/local/plan"), 2);
+  EXPECT_EQ(map.shard("nav"), 0);
+}
+
+TEST(ShardMap, HashIsStableAndInRange)
+{
+  BF::ShardMap a(4), b(4);
+  std::vector<int> used(4, 0);
+
+  for (int i = 0; i < 200; i++) {
+    std::string key = "key_" + std::to_string(i);
+    int shard = a.shard(key);
+    ASSERT_GE(shard, 0);
+    ASSERT_LT(shard, 4);
+    EXPECT_EQ(shard, b.shard(key));
+    used[shard]++;
+  }
+  // FNV-1a spreads the keys over every shard
+  for (int n : used) {
+    EXPECT_GT(n, 0);
+  }
+}
@@ -0,0 +1,153 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "behaviorfleets/LatencyHistogram.hpp"
+
+namespace
+{
+
+constexpr double US = 1e-6;
+
+// (midpoint in us, count) of every non empty bucket
+std::vector<std::pair<double, uint64_t>> buckets(const BF::LatencyHistogram & histogram)
+{
+  std::vector<std::pair<double, uint64_t>> result;
+  histogram.for_each(
+    [&result](double seconds, uint64_t count) {
+      result.emplace_back(seconds / US, count);
+    });
+  return result;
+}
+
+}  // namespace
+
+TEST(LatencyHistogram, Empty)
+{
+  BF::LatencyHistogram histogram;
+
+  EXPECT_EQ(histogram.count(), 0u);
+  EXPECT_EQ(histogram.mean(), 0.0);
+  EXPECT_EQ(histogram.max(), 0.0);
+  EXPECT_EQ(histogram.percentile(50), 0.0);
+  EXPECT_TRUE(buckets(histogram).empty());
+}
+
+TEST(LatencyHistogram, CountMeanMax)
+{
+  BF::LatencyHistogram histogram;
+  histogram.record(0.001);
+  histogram.record(0.002);
+  histogram.record(0.003);
+  histogram.record(-1.0);  // clock went backwards: counted as 0
+
+  EXPECT_EQ(histogram.count(), 4u);
+  EXPECT_NEAR(histogram.mean(), 0.0015, 1e-12);
+  EXPECT_NEAR(histogram.max(), 0.003, 1e-12);
+}
+
+TEST(LatencyHistogram, ExactBelow32us)
+{
+  BF::LatencyHistogram histogram;
+  for (int us = 1; us <= 31; us++) {
+    histogram.record(us * US);
+  }
+
+  auto b = buckets(histogram);
+  ASSERT_EQ(b.size(), 31u);
+  EXPECT_NEAR(b.front().first, 1.5, 1e-9);
+  EXPECT_NEAR(b.back().first, 31.5, 1e-9);
+
+  EXPECT_NEAR(histogram.percentile(50), 16 * US, 1e-12);
+  EXPECT_NEAR(histogram.percentile(0), 1 * US, 1e-12);
+  EXPECT_NEAR(histogram.percentile(100), 31 * US, 1e-12);
+}
+
+TEST(LatencyHistogram, BucketWidthDoublesEachPowerOfTwo)
+{
+  BF::LatencyHistogram histogram;
+  histogram.record(63 * US);  // last bucket of width 1
+  histogram.record(64 * US);  // width 2 from here on
+  histogram.record(65 * US);
+  histogram.record(66 * US);
+  histogram.record(128 * US);  // width 4
+  histogram.record(131 * US);
+
+  auto b = buckets(histogram);
+  ASSERT_EQ(b.size(), 4u);
+  EXPECT_EQ(b[0], std::make_pair(63.5, uint64_t(1)));
+  EXPECT_EQ(b[1], std::make_pair(65.0, uint64_t(2)));
+  EXPECT_EQ(b[2], std::make_pair(67.0, uint64_t(1)));
+  EXPECT_EQ(b[3], std::make_pair(130.0, uint64_t(2)));
+}
+
+TEST(LatencyHistogram, RelativeErrorBound)
+{
+  // the top of the bucket of any value is within 1/32 of it
+  for (double seconds : {37 * US, 1000 * US, 123456 * US, 0.5, 7.25, 3600.0}) {
+    BF::LatencyHistogram histogram;
+    histogram.record(seconds);
+    histogram.record(1e6);  // so that the first bucket is not capped by the maximum
+
+    double p = histogram.percentile(50);
+    EXPECT_GE(p, seconds * (1 - 1e-9)) << seconds;
+    EXPECT_LE(p, seconds * (1 + 1.0 / 32)) << seconds;
+  }
+}
+
+TEST(LatencyHistogram, Percentiles)
+{
+  BF::LatencyHistogram histogram;
+  for (int us = 1; us <= 10000; us++) {
+    histogram.record(us * US);
+  }
+
+  EXPECT_EQ(histogram.count(), 10000u);
+  EXPECT_NEAR(histogram.percentile(50), 5000 * US, 5000 * US / 32);
+  EXPECT_NEAR(histogram.percentile(90), 9000 * US, 9000 * US / 32);
+  EXPECT_NEAR(histogram.percentile(99), 9900 * US, 9900 * US / 32);
+  // never above the real maximum
+  EXPECT_NEAR(histogram.percentile(100), 10000 * US, 1e-12);
+  EXPECT_LE(histogram.percentile(50), histogram.percentile(90));
+  EXPECT_LE(histogram.percentile(90), histogram.percentile(99));
+}
+
+TEST(LatencyHistogram, HugeValuesAreCounted)
+{
+  BF::LatencyHistogram histogram;
+  histogram.record(1e9);
+  histogram.record(1e10);
+
+  auto b = buckets(histogram);
+  ASSERT_EQ(b.size(), 1u);
+  EXPECT_EQ(b.front().second, 2u);
+  EXPECT_NEAR(histogram.max(), 1e10, 1e-3);
+}
+
+TEST(LatencyHistogram, Reset)
+{
+  BF::LatencyHistogram histogram;
+  histogram.record(0.01);
+  histogram.reset();
+
+  EXPECT_EQ(histogram.count(), 0u);
+  EXPECT_EQ(histogram.max(), 0.0);
+  EXPECT_EQ(histogram.percentile(99), 0.0);
+  EXPECT_TRUE(buckets(histogram).empty());
+}
@@ -0,0 +1,132 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "behaviorfleets/MpscQueue.hpp"
+
+TEST(MpscQueue, Empty)
+{
+  BF::MpscQueue<int> queue;
+  int item = -1;
+
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.pop(item));
+  EXPECT_EQ(item, -1);
+}
+
+TEST(MpscQueue, FifoOrder)
+{
+  BF::MpscQueue<int> queue;
+  for (int i = 0; i < 100; i++) {
+    queue.push(i);
+  }
+
+  int item;
+  for (int i = 0; i < 100; i++) {
+    ASSERT_FALSE(queue.empty());
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, i);
+  }
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.pop(item));
+}
+
+TEST(MpscQueue, InterleavedPushPop)
+{
+  BF::MpscQueue<int> queue;
+  int item;
+
+  queue.push(1);
+  queue.push(2);
+  ASSERT_TRUE(queue.pop(item));
+  EXPECT_EQ(item, 1);
+  queue.push(3);
+  ASSERT_TRUE(queue.pop(item));
+  EXPECT_EQ(item, 2);
+  ASSERT_TRUE(queue.pop(item));
+  EXPECT_EQ(item, 3);
+  EXPECT_FALSE(queue.pop(item));
+}
+
+TEST(MpscQueue, MoveOnlyItems)
+{
+  BF::MpscQueue<std::unique_ptr<int>> queue;
+  queue.push(std::make_unique<int>(7));
+
+  std::unique_ptr<int> item;
+  ASSERT_TRUE(queue.pop(item));
+  ASSERT_NE(item, nullptr);
+  EXPECT_EQ(*item, 7);
+}
+
+TEST(MpscQueue, DestructorReleasesPendingItems)
+{
+  auto item = std::make_shared<int>(0);
+  {
+    BF::MpscQueue<std::shared_ptr<int>> queue;
+    queue.push(item);
+    queue.push(item);
+    EXPECT_EQ(item.use_count(), 3);
+  }
+  EXPECT_EQ(item.use_count(), 1);
+}
+
+// the order of the items of each producer is kept, whatever the interleaving
+TEST(MpscQueue, ManyProducersOneConsumer)
+{
+  constexpr int PRODUCERS = 4;
+  constexpr int ITEMS = 20000;
+  BF::MpscQueue<std::pair<int, int>> queue;
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCERS; p++) {
+    producers.emplace_back(
+      [&queue, p]() {
+        for (int i = 0; i < ITEMS; i++) {
+          queue.push({p, i});
+        }
+      });
+  }
+
+  std::vector<std::pair<int, int>> received;
+  std::pair<int, int> item;
+  while (received.size() < PRODUCERS * ITEMS) {
+    if (queue.pop(item)) {
+      received.push_back(item);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  for (auto & producer : producers) {
+    producer.join();
+  }
+
+  std::vector<int> next(PRODUCERS, 0);
+  for (const auto & [p, i] : received) {
+    ASSERT_GE(p, 0);
+    ASSERT_LT(p, PRODUCERS);
+    ASSERT_EQ(i, next[p]);
+    next[p]++;
+  }
+  EXPECT_TRUE(queue.empty());
+  for (int p = 0; p < PRODUCERS; p++) {
+    EXPECT_EQ(next[p], ITEMS);
+  }
+}
@@ -0,0 +1,185 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "behaviorfleets/PayloadCodec.hpp"
+
+using bf_msgs::msg::Blackboard;
+using bf_msgs::msg::BlackboardEntry;
+
+namespace
+{
+
+BlackboardEntry string_entry(const std::string & key, const std::string & value)
+{
+  BlackboardEntry entry;
+  entry.key = key;
+  entry.type = BlackboardEntry::STRING;
+  entry.string_value = value;
+  entry.version = 7;
+  return entry;
+}
+
+Blackboard large_message()
+{
+  Blackboard msg;
+  msg.type = Blackboard::PUBLISH;
+  msg.robot_id = "r1";
+  for (int i = 0; i < 8; i++) {
+    msg.entries.push_back(
+      string_entry("team_a/waypoint_" + std::to_string(i), std::string(256, 'a' + i)));
+  }
+  BlackboardEntry pose;
+  pose.key = "pose";
+  pose.type = BlackboardEntry::DOUBLE;
+  pose.double_value = 1.5;
+  msg.entries.push_back(pose);
+  return msg;
+}
+
+}  // namespace
+
+TEST(PayloadCodec, DisabledLeavesMessagesAlone)
+{
+  BF::PayloadCodec codec;
+  auto msg = large_message();
+
+  EXPECT_FALSE(codec.enabled());
+  EXPECT_EQ(codec.compress(msg), 0u);
+  EXPECT_EQ(msg.compression, Blackboard::COMPRESSION_NONE);
+  EXPECT_EQ(msg.entries.size(), 9u);
+  EXPECT_TRUE(msg.payload.empty());
+  EXPECT_TRUE(codec.decompress(msg));
+  EXPECT_EQ(msg.entries.size(), 9u);
+}
+
+TEST(PayloadCodec, RoundTrip)
+{
+  BF::PayloadCodec codec(64);
+  auto original = large_message();
+  auto msg = original;
+
+  size_t raw_size = codec.compress(msg);
+  EXPECT_GT(raw_size, 0u);
+  EXPECT_EQ(msg.compression, Blackboard::COMPRESSION_ZSTD);
+  EXPECT_TRUE(msg.entries.empty());
+  EXPECT_LT(msg.payload.size(), raw_size);
+  // the header of the message is not compressed
+  EXPECT_EQ(msg.robot_id, "r1");
+  EXPECT_EQ(msg.type, Blackboard::PUBLISH);
+
+  // compressing twice does nothing
+  EXPECT_EQ(codec.compress(msg), 0u);
+
+  ASSERT_TRUE(codec.decompress(msg));
+  EXPECT_EQ(msg.compression, Blackboard::COMPRESSION_NONE);
+  EXPECT_TRUE(msg.payload.empty());
+  ASSERT_EQ(msg.entries.size(), original.entries.size());
+  for (size_t i = 0; i < msg.entries.size(); i++) {
+    EXPECT_EQ(msg.entries[i].key, original.entries[i].key);
+    EXPECT_EQ(msg.entries[i].type, original.entries[i].type);
+    EXPECT_EQ(msg.entries[i].string_value, original.entries[i].string_value);
+    EXPECT_EQ(msg.entries[i].version, original.entries[i].version);
+  }
+  EXPECT_EQ(msg.entries.back().double_value, 1.5);
+}
+
+TEST(PayloadCodec, SmallMessagesAreNotCompressed)
+{
+  BF::PayloadCodec codec(4096);
+  Blackboard msg;
+  msg.entries.push_back(string_entry("goal", "kitchen"));
+
+  EXPECT_EQ(codec.compress(msg), 0u);
+  EXPECT_EQ(msg.compression, Blackboard::COMPRESSION_NONE);
+  ASSERT_EQ(msg.entries.size(), 1u);
+  EXPECT_EQ(msg.entries[0].string_value, "kitchen");
+}
+
+TEST(PayloadCodec, IncompressibleEntriesGoAsTheyAre)
+{
+  BF::PayloadCodec codec(64);
+  std::mt19937 random(42);
+  BlackboardEntry image;
+  image.key = "image";
+  image.type = BlackboardEntry::BYTES;
+  for (int i = 0; i < 4096; i++) {
+    image.bytes_value.push_back(static_cast<uint8_t>(random()));
+  }
+  Blackboard msg;
+  msg.entries.push_back(image);
+
+  EXPECT_EQ(codec.compress(msg), 0u);
+  EXPECT_EQ(msg.compression, Blackboard::COMPRESSION_NONE);
+  EXPECT_TRUE(msg.payload.empty());
+  ASSERT_EQ(msg.entries.size(), 1u);
+  EXPECT_EQ(msg.entries[0].bytes_value, image.bytes_value);
+}
+
+TEST(PayloadCodec, BadPayloadsAreRejected)
+{
+  BF::PayloadCodec codec(64);
+  auto msg = large_message();
+  ASSERT_GT(codec.compress(msg), 0u);
+
+  auto truncated = msg;
+  truncated.payload.resize(truncated.payload.size() / 2);
+  EXPECT_FALSE(codec.decompress(truncated));
+
+  auto garbage = msg;
+  garbage.payload.assign(64, 0xAB);
+  EXPECT_FALSE(codec.decompress(garbage));
+
+  auto unknown = msg;
+  unknown.compression = 42;
+  EXPECT_FALSE(codec.decompress(unknown));
+}
+
+TEST(PayloadCodec, Negotiation)
+{
+  BF::PayloadCodec codec(64);
+  Blackboard msg;
+  EXPECT_FALSE(codec.readable_by(msg));  // nothing advertised
+
+  codec.advertise(msg);
+  EXPECT_TRUE(msg.accepts_zstd);
+  EXPECT_EQ(msg.dictionary_id, 0u);
+  EXPECT_TRUE(codec.readable_by(msg));
+  // a disabled codec still reads compressed payloads
+  EXPECT_TRUE(BF::PayloadCodec().readable_by(msg));
+
+  msg.dictionary_id = 1234;  // another dictionary
+  EXPECT_FALSE(codec.readable_by(msg));
+}
+
+TEST(PayloadCodec, MissingDictionaryDisablesCompression)
+{
+  BF::PayloadCodec codec(64, "/nonexistent/bb.dict");
+
+  EXPECT_TRUE(codec.dictionary_failed());
+  EXPECT_FALSE(codec.enabled());
+
+  Blackboard msg;
+  codec.advertise(msg);
+  EXPECT_FALSE(msg.accepts_zstd);
+
+  auto large = large_message();
+  EXPECT_EQ(codec.compress(large), 0u);
+}
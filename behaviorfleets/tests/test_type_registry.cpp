@@ -0,0 +1,279 @@
+// Copyright 2023 Intelligent Robotics Lab
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "behaviortree_cpp/blackboard.h"
+
+#include "behaviorfleets/TypeRegistry.hpp"
+
+using bf_msgs::msg::BlackboardEntry;
+
+namespace
+{
+
+struct Point
+{
+  double x;
+  double y;
+};
+
+struct Label
+{
+  std::string text;
+};
+
+// sends bb_from[key] through an entry into bb_to, as the handler and the manager do
+BlackboardEntry round_trip(
+  const BT::Blackboard::Ptr & bb_from, const std::string & key,
+  const BT::Blackboard::Ptr & bb_to)
+{
+  BlackboardEntry entry;
+  EXPECT_TRUE(BF::TypeRegistry::instance().encode(bb_from, key, &entry));
+  EXPECT_TRUE(BF::TypeRegistry::instance().decode(entry, bb_to));
+  return entry;
+}
+
+}  // namespace
+
+TEST(TypeRegistry, BuiltinTypesRoundTrip)
+{
+  auto from = BT::Blackboard::create();
+  auto to = BT::Blackboard::create();
+  from->set("int", -42);
+  from->set("double", 2.5);
+  from->set("bool", true);
+  from->set("string", std::string("kitchen"));
+  from->set("bytes", std::vector<uint8_t>{1, 2, 3});
+
+  EXPECT_EQ(round_trip(from, "int", to).type, BlackboardEntry::INT);
+  EXPECT_EQ(round_trip(from, "double", to).type, BlackboardEntry::DOUBLE);
+  EXPECT_EQ(round_trip(from, "bool", to).type, BlackboardEntry::BOOL);
+  EXPECT_EQ(round_trip(from, "string", to).type, BlackboardEntry::STRING);
+  EXPECT_EQ(round_trip(from, "bytes", to).type, BlackboardEntry::BYTES);
+
+  EXPECT_EQ(to->get<int>("int"), -42);
+  EXPECT_DOUBLE_EQ(to->get<double>("double"), 2.5);
+  EXPECT_TRUE(to->get<bool>("bool"));
+  EXPECT_EQ(to->get<std::string>("string"), "kitchen");
+  EXPECT_EQ(to->get<std::vector<uint8_t>>("bytes"), (std::vector<uint8_t>{1, 2, 3}));
+}
+
+TEST(TypeRegistry, ExistingKeysKeepTheirType)
+{
+  auto from = BT::Blackboard::create();
+  auto to = BT::Blackboard::create();
+  from->set("count", 7);
+  to->set("count", 0u);
+
+  round_trip(from, "count", to);
+  EXPECT_EQ(to->getAny("count")->type(), std::type_index(typeid(unsigned int)));
+  EXPECT_EQ(to->get<unsigned int>("count"), 7u);
+}
+
+TEST(TypeRegistry, IncompatibleTypesAreRejected)
+{
+  auto to = BT::Blackboard::create();
+  to->set("goal", std::string("kitchen"));
+
+  BlackboardEntry entry;
+  entry.key = "goal";
+  entry.type = BlackboardEntry::INT;
+  entry.int_value = 3;
+  EXPECT_FALSE(BF::TypeRegistry::instance().decode(entry, to));
+  EXPECT_EQ(to->get<std::string>("goal"), "kitchen");
+}
+
+TEST(TypeRegistry, UnsupportedTypesAreNotEncoded)
+{
+  auto bb = BT::Blackboard::create();
+  bb->set("node", std::make_shared<int>(1));
+
+  BlackboardEntry entry;
+  EXPECT_FALSE(BF::TypeRegistry::instance().encode(bb, "node", &entry));
+  EXPECT_FALSE(BF::TypeRegistry::instance().encode(bb, "missing", &entry));
+  EXPECT_EQ(BF::TypeRegistry::instance().tag(bb, "node"), BF::TypeRegistry::UNSUPPORTED);
+}
+
+TEST(TypeRegistry, TrivialCustomTypeRoundTrip)
+{
+  BF::TypeRegistry::instance().register_trivial<Point>("test/Point");
+  auto from = BT::Blackboard::create();
+  auto to = BT::Blackboard::create();
+  from->set("target", Point{1.5, -2.0});
+
+  auto entry = round_trip(from, "target", to);
+  EXPECT_EQ(entry.type, BlackboardEntry::CUSTOM);
+  EXPECT_EQ(entry.type_name, "test/Point");
+  EXPECT_EQ(entry.bytes_value.size(), sizeof(Point));
+
+  auto target = to->get<Point>("target");
+  EXPECT_DOUBLE_EQ(target.x, 1.5);
+  EXPECT_DOUBLE_EQ(target.y, -2.0);
+
+  // a payload of another size is not a Point
+  entry.bytes_value.pop_back();
+  EXPECT_FALSE(BF::TypeRegistry::instance().decode(entry, to));
+}
+
+TEST(TypeRegistry, SerializedCustomTypeRoundTrip)
+{
+  BF::TypeRegistry::instance().register_type<Label>(
+    "test/Label",
+    [](const Label & value, std::vector<uint8_t> * bytes) {
+      bytes->assign(value.text.begin(), value.text.end());
+    },
+    [](const std::vector<uint8_t> & bytes, Label * value) {
+      if (bytes.empty()) {
+        return false;
+      }
+      value->text.assign(bytes.begin(), bytes.end());
+      return true;
+    });
+  auto from = BT::Blackboard::create();
+  auto to = BT::Blackboard::create();
+  from->set("label", Label{"dock"});
+
+  auto entry = round_trip(from, "label", to);
+  EXPECT_EQ(entry.type_name, "test/Label");
+  EXPECT_EQ(to->get<Label>("label").text, "dock");
+
+  entry.bytes_value.clear();
+  EXPECT_FALSE(BF::TypeRegistry::instance().decode(entry, to));
+  EXPECT_EQ(to->get<Label>("label").text, "dock");
+}
+
+TEST(TypeRegistry, UnknownCustomTypesAreKeptOpaque)
+{
+  BlackboardEntry entry;
+  entry.key = "map";
+  entry.type = BlackboardEntry::CUSTOM;
+  entry.type_name = "test/NotRegistered";
+  entry.bytes_value = {9, 8, 7};
+
+  // e.g. in the manager: the value is kept as it came...
+  auto manager = BT::Blackboard::create();
+  ASSERT_TRUE(BF::TypeRegistry::instance().decode(entry, manager));
+  EXPECT_EQ(manager->getAny("map")->type(), std::type_index(typeid(BF::OpaqueValue)));
+
+  // ...and forwarded unchanged
+  BlackboardEntry forwarded;
+  ASSERT_TRUE(BF::TypeRegistry::instance().encode(manager, "map", &forwarded));
+  EXPECT_EQ(forwarded.type, BlackboardEntry::CUSTOM);
+  EXPECT_EQ(forwarded.type_name, "test/NotRegistered");
+  EXPECT_EQ(forwarded.bytes_value, entry.bytes_value);
+
+  // an opaque key takes a value of any other custom type
+  entry.type_name = "test/AlsoNotRegistered";
+  entry.bytes_value = {1};
+  ASSERT_TRUE(BF::TypeRegistry::instance().decode(entry, manager));
+  EXPECT_EQ(manager->get<BF::OpaqueValue>("map").type_name, "test/AlsoNotRegistered");
+}
+
+TEST(Fingerprint, EqualValuesHaveEqualFingerprints)
+{
+  BlackboardEntry a;
+  a.key = "pose_x";
+  a.type = BlackboardEntry::DOUBLE;
+  a.double_value = 1.25;
+  a.version = 3;
+  BlackboardEntry b = a;
+  b.key = "other";
+  b.version = 9;
+
+  // keys and versions are not part of the value
+  EXPECT_TRUE(BF::same_value(a, b));
+  EXPECT_EQ(BF::fingerprint(a), BF::fingerprint(b));
+}
+
+TEST(Fingerprint, ChangedValuesAreDetected)
+{
+  BlackboardEntry entry;
+  entry.type = BlackboardEntry::INT;
+  entry.int_value = 41;
+  BlackboardEntry changed = entry;
+  changed.int_value = 42;
+  EXPECT_FALSE(BF::same_value(entry, changed));
+  EXPECT_NE(BF::fingerprint(entry), BF::fingerprint(changed));
+
+  entry.type = changed.type = BlackboardEntry::STRING;
+  entry.string_value = "kitchen";
+  changed.string_value = "kitchem";
+  EXPECT_FALSE(BF::same_value(entry, changed));
+  EXPECT_NE(BF::fingerprint(entry), BF::fingerprint(changed));
+
+  entry.type = changed.type = BlackboardEntry::BYTES;
+  entry.bytes_value = {1, 2, 3};
+  changed.bytes_value = {1, 2, 3, 0};
+  EXPECT_FALSE(BF::same_value(entry, changed));
+  EXPECT_NE(BF::fingerprint(entry), BF::fingerprint(changed));
+
+  entry.type = changed.type = BlackboardEntry::BOOL;
+  entry.bool_value = false;
+  changed.bool_value = true;
+  EXPECT_FALSE(BF::same_value(entry, changed));
+  EXPECT_NE(BF::fingerprint(entry), BF::fingerprint(changed));
+}
+
+TEST(Fingerprint, TypeIsPartOfTheValue)
+{
+  BlackboardEntry as_int;
+  as_int.type = BlackboardEntry::INT;
+  BlackboardEntry as_bool;
+  as_bool.type = BlackboardEntry::BOOL;
+  BlackboardEntry as_string;
+  as_string.type = BlackboardEntry::STRING;
+
+  // all zero or empty, but not the same value
+  EXPECT_FALSE(BF::same_value(as_int, as_bool));
+  EXPECT_NE(BF::fingerprint(as_int), BF::fingerprint(as_bool));
+  EXPECT_NE(BF::fingerprint(as_int), BF::fingerprint(as_string));
+
+  // the fields of other types are ignored
+  BlackboardEntry a = as_int, b = as_int;
+  b.string_value = "leftover";
+  b.double_value = 3.0;
+  EXPECT_TRUE(BF::same_value(a, b));
+  EXPECT_EQ(BF::fingerprint(a), BF::fingerprint(b));
+}
+
+TEST(Fingerprint, CustomTypeNameIsPartOfTheValue)
+{
+  BlackboardEntry a;
+  a.type = BlackboardEntry::CUSTOM;
+  a.type_name = "test/Point";
+  a.bytes_value = {1, 2};
+  BlackboardEntry b = a;
+  b.type_name = "test/Pose";
+  EXPECT_FALSE(BF::same_value(a, b));
+  EXPECT_NE(BF::fingerprint(a), BF::fingerprint(b));
+
+  // the name and the bytes are not simply concatenated
+  BlackboardEntry c = a;
+  c.type_name = "test/Point\x01";
+  c.bytes_value = {2};
+  EXPECT_NE(BF::fingerprint(a), BF::fingerprint(c));
+
+  // custom and plain bytes differ even with the same payload
+  BlackboardEntry bytes;
+  bytes.type = BlackboardEntry::BYTES;
+  bytes.bytes_value = a.bytes_value;
+  EXPECT_FALSE(BF::same_value(a, bytes));
+  EXPECT_NE(BF::fingerprint(a), BF::fingerprint(bytes));
+}